@@ -7,259 +7,3937 @@
 #include <chrono>
 #include <atomic>
 #include <cstdlib>
+#include <cmath>
 #include <iomanip>
 #include <ctime>
 #include <memory>
+#include <random>
+#include <deque>
+#include <functional>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <limits>
+#include <algorithm>
+#include <map>
+#include <array>
+#include <numeric>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <cstring>
+
+#include "Simulation.h"
+#include "SimulationEngine.h"
 
 using namespace std;
 
-// Priority Levels
-enum Priority { HIGH, MEDIUM, LOW };
+// Logical thread ids of the threaded mode, the same in every run
+enum ScheduleThread { THREAD_MAIN = 0, THREAD_TIMER = 1, THREAD_ARRIVALS = 2, THREAD_RESOURCES = 3, THREAD_STAFF = 4,
+                      THREAD_DOCTOR_BASE = 10 };
+thread_local int scheduleThread = THREAD_MAIN;
+thread_local bool clockActor = false; // one of those threads, not a helper such as the dashboard
+
+// Length of a span of simulated seconds on the simulation clock
+chrono::steady_clock::duration simDuration(double seconds) {
+    return chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(seconds));
+}
+
+// Record/replay of the threaded mode (recordSchedule, replaySchedule). Both
+// runs pass the clock's baton as in virtual time, but on the wall clock: one
+// thread runs at a time, and every lock, condition or semaphore wait, timer
+// and sleep hands the baton on. The interleaving then follows from the seed
+// and from the times the threads read, so those are recorded: every clock
+// read of a thread, plus every hand-off as a check. Replay feeds the reads
+// back and runs as fast as virtual time. Any other hand-off or read is a
+// divergence, and so is an event stream (EventLog digest) that differs from
+// the recording's at the end.
+class ScheduleLog {
+private:
+    enum Kind { CLOCK_READ, HANDOFF };
+    struct Step {
+        Kind kind;
+        long long value;   // nanoseconds since the start, or the thread given the baton
+    };
+    enum Mode { OFF, RECORD, REPLAY };
+
+    Mode mode = OFF;
+    bool replayed = false;
+    vector<Step> steps;
+    size_t cursor = 0;
+    unsigned int seed = 0;
+    size_t events = 0;
+    uint64_t eventDigest = 0;
+    string divergence;
+
+    void diverge(const string& reason) {
+        if (divergence.empty()) divergence = reason;
+        mode = OFF;
+    }
+
+    static string kindName(Kind kind) { return kind == CLOCK_READ ? "clock read" : "hand-off"; }
+
+    // Next recorded step, which must be of this kind
+    bool follow(Kind kind, long long& value) {
+        if (cursor == steps.size()) {
+            diverge("the run went on past the recording with a " + kindName(kind));
+            return false;
+        }
+        if (steps[cursor].kind != kind) {
+            diverge("step " + to_string(cursor) + " is a " + kindName(kind) + " where the recording has a " +
+                    kindName(steps[cursor].kind));
+            return false;
+        }
+        value = steps[cursor++].value;
+        return true;
+    }
+
+public:
+    void startRecording(unsigned int runSeed) {
+        steps.clear();
+        steps.reserve(1 << 16);
+        seed = runSeed;
+        replayed = false;
+        mode = RECORD;
+    }
+
+    // Loads a recording; replay starts with startReplay()
+    bool load(const string& path) {
+        ifstream in(path);
+        string seedTag, eventsTag;
+        if (!(in >> seedTag >> seed >> eventsTag >> events >> eventDigest) || seedTag != "seed" ||
+            eventsTag != "events") {
+            return false;
+        }
+        steps.clear();
+        char kind;
+        long long value;
+        while (in >> kind >> value) {
+            if (kind != 'c' && kind != 'h') return false;
+            steps.push_back({kind == 'c' ? CLOCK_READ : HANDOFF, value});
+        }
+        return in.eof();
+    }
+
+    void startReplay() {
+        cursor = 0;
+        divergence.clear();
+        replayed = true;
+        mode = REPLAY;
+    }
+
+    bool save(const string& path, size_t eventCount, uint64_t digest) const {
+        ofstream out(path);
+        out << "seed " << seed << "\nevents " << eventCount << ' ' << digest << '\n';
+        for (const Step& step : steps) out << (step.kind == CLOCK_READ ? 'c' : 'h') << ' ' << step.value << '\n';
+        return (bool)out;
+    }
+
+    // The clock calls these with its lock held
+    void recordClock(long long nanos) {
+        if (mode == RECORD) steps.push_back({CLOCK_READ, nanos});
+    }
+
+    // Replaces a clock read with the recorded one; false once replay is over
+    bool replayClock(long long& nanos) { return mode == REPLAY && follow(CLOCK_READ, nanos); }
+
+    void handOff(int thread) {
+        long long recorded;
+        if (mode == RECORD) {
+            steps.push_back({HANDOFF, thread});
+        } else if (mode == REPLAY && follow(HANDOFF, recorded) && recorded != thread) {
+            diverge("step " + to_string(cursor - 1) + " hands the baton to thread " + to_string(thread) +
+                    " where the recording has thread " + to_string(recorded));
+        }
+    }
+
+    // Ends the run. A replay must use up the recording and give the same events.
+    void finish(size_t eventCount, uint64_t digest) {
+        if (mode == REPLAY && cursor < steps.size()) {
+            diverge("the run ended at step " + to_string(cursor) + " of " + to_string(steps.size()));
+        }
+        if (replayed && divergence.empty() && (eventCount != events || digest != eventDigest)) {
+            diverge("the event stream differs from the recording (" + to_string(eventCount) + " records, " +
+                    to_string(events) + " recorded)");
+        }
+        mode = OFF;
+    }
+
+    bool recording() const { return mode == RECORD; }
+    bool wasReplayed() const { return replayed; }
+    unsigned int recordedSeed() const { return seed; }
+    size_t size() const { return steps.size(); }
+    size_t followed() const { return cursor; }
+    const string& divergenceReason() const { return divergence; }
+};
+
+ScheduleLog scheduleLog;
+
+// Clock of the threaded mode. In real time the threads sleep on the wall clock,
+// sped up by a factor (clockSpeed): simulated time is the wall time since the
+// start times the speed. Sleeps go to absolute deadlines, so loops that sleep
+// a fixed interval do not drift, and every late wake-up is measured by the lag
+// monitor. In virtual time (clock = virtual) the threads keep their structure but share
+// a single baton: only the holder runs. A blocking sleep, lock or condition
+// wait passes the baton to the next ready thread. When every thread is
+// blocked, the clock jumps to the earliest wake-up. Runs are then
+// deterministic and go as fast as the CPU allows. Record/replay passes the
+// baton the same way in real time: a thread given the baton for its deadline
+// waits for it on the wall clock (see ScheduleLog).
+class SimulationClock {
+private:
+    struct Actor {
+        int id = 0;                      // ScheduleThread
+        bool go = false;                 // holds the baton
+        bool exited = false;
+        const void* channel = nullptr;   // what it is blocked on, if anything
+        unsigned long long token = 0;    // invalidates a pending timed wake-up
+        long long wakeAt = -1;           // recording: given the baton for this deadline
+        condition_variable goCv;
+    };
+    struct WakeUp {
+        long long time;
+        unsigned long long seq;
+        Actor* actor;
+        unsigned long long token;
+    };
+    struct LaterWakeUp {
+        bool operator()(const WakeUp& a, const WakeUp& b) const {
+            if (a.time == b.time) return a.seq > b.seq;
+            return a.time > b.time;
+        }
+    };
+
+    atomic<bool> serialized{false};      // the threads take turns with the baton
+    bool wallTime = false;               // serialized on the wall clock (record/replay)
+    bool replay = false;                 // clock reads come from the schedule
+    atomic<long long> nowNanos{0};
+    chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+    double speed = 1;
+    mutex mtx;
+
+    // Lag monitor of real time, in wall nanoseconds
+    long long lagToleranceNanos = 50000000;
+    atomic<long long> wakeUps{0};
+    atomic<long long> lateWakeUps{0};
+    atomic<long long> maxLagNanos{0};
+    atomic<long long> lastWarningNanos{-1000000000};
+
+public:
+    // Records how late a real-time sleep woke up; warns at most once a second
+    // while the engine is behind the requested speed
+    void measureLag(chrono::steady_clock::time_point deadline) {
+        auto wall = chrono::steady_clock::now();
+        long long lag = chrono::duration_cast<chrono::nanoseconds>(wall - toWall(deadline)).count();
+        wakeUps++;
+        long long worst = maxLagNanos;
+        while (lag > worst && !maxLagNanos.compare_exchange_weak(worst, lag)) {}
+        if (lag <= lagToleranceNanos) return;
+        lateWakeUps++;
+        long long at = chrono::duration_cast<chrono::nanoseconds>(wall - epoch).count();
+        long long last = lastWarningNanos;
+        if (at - last >= 1000000000 && lastWarningNanos.compare_exchange_strong(last, at)) {
+            cerr << "Clock lag: woke " << lag / 1e6 << " ms late (" << lag * speed / 1e9
+                 << " simulated s) at " << speed << "x" << endl;
+        }
+    }
+
+private:
+    unordered_map<int, unique_ptr<Actor>> actors;
+    deque<Actor*> ready;
+    priority_queue<WakeUp, vector<WakeUp>, LaterWakeUp> sleepers;
+    unordered_map<const void*, deque<Actor*>> channels;
+    unsigned long long nextSeq = 0;
+    Actor* controller = nullptr;         // the thread that started virtual time
+    bool deadlocked = false;
+
+    void removeFromChannel(Actor* actor) {
+        if (!actor->channel) return;
+        deque<Actor*>& waiters = channels[actor->channel];
+        waiters.erase(find(waiters.begin(), waiters.end(), actor));
+        actor->channel = nullptr;
+    }
+
+    // Gives the baton to the next ready thread, or to the earliest sleeper
+    // after moving the clock forward (mtx held)
+    void passBaton() {
+        Actor* next = nullptr;
+        if (!ready.empty()) {
+            next = ready.front();
+            ready.pop_front();
+        }
+        while (!next && !sleepers.empty()) {
+            WakeUp w = sleepers.top();
+            sleepers.pop();
+            if (w.token != w.actor->token) continue; // Woken through its channel already
+            if (wallTime && !replay) {
+                w.actor->wakeAt = w.time;
+            } else {
+                nowNanos = max(nowNanos.load(), w.time);
+            }
+            removeFromChannel(w.actor);
+            w.actor->token++;
+            next = w.actor;
+        }
+        if (!next && controller && !controller->exited && any_of(actors.begin(), actors.end(), [](const auto& a) {
+                return !a.second->exited;
+            })) {
+            // Every thread is blocked and none has a deadline: the controller
+            // wakes up to stop the run (awaitExit fails from now on)
+            if (!deadlocked) cerr << "Virtual clock: every thread is blocked at t = " << nowNanos / 1e9 << " s" << endl;
+            deadlocked = true;
+            removeFromChannel(controller);
+            controller->token++;
+            next = controller;
+        }
+        if (next) {
+            scheduleLog.handOff(next->id);
+            next->go = true;
+            next->goCv.notify_one();
+        }
+    }
+
+    chrono::steady_clock::time_point scaledWall() const {
+        auto wall = chrono::steady_clock::now();
+        if (speed == 1) return wall;
+        return epoch + chrono::duration_cast<chrono::steady_clock::duration>((wall - epoch) * speed);
+    }
+
+    void startBaton(bool onWallClock, bool replaying) {
+        lock_guard<mutex> lock(mtx);
+        actors.clear();
+        ready.clear();
+        sleepers = {};
+        channels.clear();
+        nowNanos = 0;
+        if (!onWallClock) epoch = chrono::steady_clock::now();
+        wallTime = onWallClock;
+        replay = replaying;
+        actors[scheduleThread].reset(new Actor);
+        actors[scheduleThread]->id = scheduleThread;
+        actors[scheduleThread]->go = true;
+        controller = actors[scheduleThread].get();
+        deadlocked = false;
+        clockActor = true;
+        serialized = true;
+    }
+
+    // Passes the baton on and waits to get it back (mtx held)
+    void switchAway(unique_lock<mutex>& lock, Actor* me) {
+        me->go = false;
+        passBaton();
+        me->goCv.wait(lock, [me] { return me->go; });
+    }
+
+public:
+    bool isSerialized() const { return serialized; }
+
+    // Starts real time at the given speed; tolerance is the lag, in wall
+    // milliseconds, above which a wake-up counts as late
+    void startReal(double factor, double toleranceMs) {
+        epoch = chrono::steady_clock::now();
+        speed = factor;
+        lagToleranceNanos = (long long)(toleranceMs * 1e6);
+        wakeUps = 0;
+        lateWakeUps = 0;
+        maxLagNanos = 0;
+    }
+
+    // Wall-clock time at which the simulation clock reaches a time point
+    chrono::steady_clock::time_point toWall(chrono::steady_clock::time_point simTime) const {
+        if (speed == 1) return simTime;
+        return epoch + chrono::duration_cast<chrono::steady_clock::duration>((simTime - epoch) / speed);
+    }
+
+    void printLagReport() const {
+        cout << "Clock: " << speed << "x, " << wakeUps << " wake-up(s), max lag " << maxLagNanos / 1e6 << " ms ("
+             << maxLagNanos * speed / 1e9 << " simulated s), " << lateWakeUps << " over the "
+             << lagToleranceNanos / 1e6 << " ms tolerance" << endl;
+    }
+
+    // Starts virtual time with the calling thread holding the baton
+    void startVirtual() { startBaton(false, false); }
+
+    // Starts real time with the baton, for a recording or a replay. A replay
+    // takes its clock reads from scheduleLog and does not wait for deadlines.
+    void startSerialized(double factor, double toleranceMs, bool replaying) {
+        startReal(factor, toleranceMs);
+        startBaton(true, replaying);
+    }
+
+    void stopVirtual() {
+        lock_guard<mutex> lock(mtx);
+        serialized = false;
+        clockActor = false;
+        controller = nullptr;
+        if (!deadlocked) return;
+        // Threads still blocked wait on their actors forever: never destroy those
+        for (auto& a : actors) {
+            if (!a.second->exited) a.second.release();
+        }
+    }
+
+    // True once every thread was found blocked with no wake-up pending
+    bool isDeadlocked() {
+        lock_guard<mutex> lock(mtx);
+        return deadlocked;
+    }
+
+    // Registers a thread about to be created; it runs after the threads already ready
+    void spawn(int id) {
+        if (!serialized) return;
+        lock_guard<mutex> lock(mtx);
+        actors[id].reset(new Actor);
+        actors[id]->id = id;
+        ready.push_back(actors[id].get());
+    }
+
+    // First call of a spawned thread: waits for the baton
+    void enter(int id) {
+        if (!serialized) return;
+        clockActor = true;
+        unique_lock<mutex> lock(mtx);
+        Actor* me = actors.at(id).get();
+        me->goCv.wait(lock, [me] { return me->go; });
+    }
+
+    void leave() {
+        if (!serialized) return;
+        clockActor = false;
+        lock_guard<mutex> lock(mtx);
+        Actor* me = actors.at(scheduleThread).get();
+        me->exited = true;
+        me->go = false;
+        for (Actor* waiter : channels[me]) {
+            waiter->channel = nullptr;
+            waiter->token++;
+            ready.push_back(waiter);
+        }
+        channels.erase(me);
+        passBaton();
+    }
+
+    // Blocks until another thread has left; false if it never will (deadlock)
+    bool awaitExit(int id) {
+        if (!serialized) return true;
+        unique_lock<mutex> lock(mtx);
+        Actor* other = actors.at(id).get();
+        Actor* me = actors.at(scheduleThread).get();
+        while (!other->exited) {
+            if (deadlocked) return false;
+            me->channel = other;
+            channels[other].push_back(me);
+            switchAway(lock, me);
+        }
+        return true;
+    }
+
+    // Blocks on a channel (a lock or condition) until wake() or the deadline
+    void block(const void* channel, chrono::steady_clock::time_point deadline = chrono::steady_clock::time_point::max()) {
+        unique_lock<mutex> lock(mtx);
+        Actor* me = actors.at(scheduleThread).get();
+        if (channel) {
+            me->channel = channel;
+            channels[channel].push_back(me);
+        }
+        if (deadline != chrono::steady_clock::time_point::max()) {
+            long long t = max(nowNanos.load(), (long long)chrono::duration_cast<chrono::nanoseconds>(deadline - epoch).count());
+            sleepers.push({t, nextSeq++, me, me->token});
+        }
+        switchAway(lock, me);
+        if (me->wakeAt >= 0) {
+            // Recording: the deadline's turn has come; wait for it on the wall clock
+            auto wakeAt = epoch + chrono::nanoseconds(me->wakeAt);
+            me->wakeAt = -1;
+            lock.unlock();
+            this_thread::sleep_until(toWall(wakeAt));
+            measureLag(wakeAt);
+        }
+    }
+
+    // Makes the threads blocked on a channel ready, in the order they blocked
+    void wake(const void* channel, bool all) {
+        lock_guard<mutex> lock(mtx);
+        auto it = channels.find(channel);
+        if (it == channels.end()) return;
+        while (!it->second.empty()) {
+            Actor* waiter = it->second.front();
+            it->second.pop_front();
+            waiter->channel = nullptr;
+            waiter->token++;
+            ready.push_back(waiter);
+            if (!all) break;
+        }
+    }
+
+    chrono::steady_clock::time_point now() {
+        if (serialized && !wallTime) return epoch + chrono::nanoseconds(nowNanos.load());
+        if (!serialized || !clockActor) return scaledWall();
+        // Record/replay: what the threads read is part of the schedule
+        lock_guard<mutex> lock(mtx);
+        long long t = nowNanos;
+        if (!replay) {
+            t = chrono::duration_cast<chrono::nanoseconds>(scaledWall() - epoch).count();
+            scheduleLog.recordClock(t);
+        } else {
+            scheduleLog.replayClock(t); // Left at the last time once the replay diverged
+        }
+        nowNanos = max(nowNanos.load(), t);
+        return epoch + chrono::nanoseconds(nowNanos.load());
+    }
+
+    void sleepUntil(chrono::steady_clock::time_point deadline) {
+        if (serialized) {
+            block(nullptr, deadline);
+        } else {
+            this_thread::sleep_until(toWall(deadline));
+            measureLag(deadline);
+        }
+    }
+
+    void sleepFor(double seconds) { sleepUntil(now() + simDuration(seconds)); }
+};
+
+SimulationClock simClock;
+
+// Marks a thread function as one actor of the threaded mode
+struct ActorScope {
+    explicit ActorScope(int id) {
+        scheduleThread = id;
+        simClock.enter(id);
+    }
+    ~ActorScope() { simClock.leave(); }
+};
+
+// Condition variable that also wakes threads blocked in virtual time
+class SimCondition {
+public:
+    condition_variable native;
+
+    void notify_one() {
+        if (simClock.isSerialized()) {
+            simClock.wake(this, false);
+        } else {
+            native.notify_one();
+        }
+    }
+
+    void notify_all() {
+        if (simClock.isSerialized()) {
+            simClock.wake(this, true);
+        } else {
+            native.notify_all();
+        }
+    }
+};
+
+// One-shot stop request of the threaded mode. Its sleeps end early once it is
+// raised, so shutdown does not wait out a break, a resource interval or a
+// treatment, in real or virtual time.
+class StopSignal {
+private:
+    mutex mtx;
+    condition_variable native;
+    atomic<bool> raised{false};
+
+public:
+    void reset() { raised = false; }
+
+    bool isRaised() const { return raised; }
+
+    void raise() {
+        {
+            lock_guard<mutex> lock(mtx);
+            raised = true;
+        }
+        if (simClock.isSerialized()) {
+            simClock.wake(this, true);
+        } else {
+            native.notify_all();
+        }
+    }
+
+    // Sleeps until the deadline on the simulation clock; false if raised first
+    bool sleepUntil(chrono::steady_clock::time_point deadline) {
+        if (raised) return false;
+        if (simClock.isSerialized()) {
+            simClock.block(this, deadline);
+            return !raised;
+        }
+        {
+            unique_lock<mutex> lock(mtx);
+            if (native.wait_until(lock, simClock.toWall(deadline), [this] { return raised.load(); })) return false;
+        }
+        simClock.measureLag(deadline);
+        return true;
+    }
+
+    bool sleepFor(double seconds) { return sleepUntil(simClock.now() + simDuration(seconds)); }
+};
+
+// Mutex of the threaded mode's shared state. While the clock passes its baton
+// it is a flag guarded by the baton, and waiting for it blocks in the clock.
+class OrderedMutex {
+public:
+    mutex raw;
+    bool held = false;
+
+    void lock() {
+        if (simClock.isSerialized()) {
+            while (held) simClock.block(this);
+            held = true;
+            return;
+        }
+        raw.lock();
+    }
+
+    void unlock() {
+        if (simClock.isSerialized()) {
+            held = false;
+            simClock.wake(this, false);
+            return;
+        }
+        raw.unlock();
+    }
+};
+
+// Condition wait on an OrderedMutex
+template <typename Predicate>
+void scheduledWait(SimCondition& cv, unique_lock<OrderedMutex>& lock, Predicate ready) {
+    if (simClock.isSerialized()) {
+        while (!ready()) {
+            lock.unlock();
+            simClock.block(&cv);
+            lock.lock();
+        }
+        return;
+    }
+    unique_lock<mutex> raw(lock.mutex()->raw, adopt_lock);
+    cv.native.wait(raw, ready);
+    raw.release();
+}
+
+// Struct for Patient
+struct Patient {
+    int id;
+    string name;
+    Priority priority;
+    Priority triage; // priority at arrival
+    unsigned long long deteriorationTimer = 0;
+    unsigned long long abandonTimer = 0;
+    chrono::steady_clock::time_point arrivalTime;
+    double waitSeconds = 0;
+    Patient(int id, string name, Priority priority, chrono::steady_clock::time_point arrivalTime)
+        : id(id), name(name), priority(priority), triage(priority), arrivalTime(arrivalTime) {}
+};
+
+// Event log of the threaded mode: every state-changing action is appended with
+// its time since the start, so a run can be rebuilt and inspected afterwards
+// (--mode=replay). Records are appended under one mutex, so the file order is
+// a valid serialization: each resource logs its changes while holding its own
+// lock, and patient records are written under queueMutex.
+enum LoggedResource { LOG_DOCTORS, LOG_NURSES, LOG_EXAM_ROOMS, LOG_VENTILATORS, LOGGED_RESOURCES };
+enum LogAction {
+    LOG_START, LOG_ARRIVAL, LOG_DEQUEUE, LOG_ACQUIRE, LOG_RELEASE, LOG_TREATMENT_START, LOG_TREATMENT_END,
+    LOG_BREAK_START, LOG_BREAK_END, LOG_RESOURCE_ADD, LOG_DETERIORATE, LOG_LEFT, LOG_ACTIONS
+};
+const char* const LOG_ACTION_NAMES[LOG_ACTIONS] = {
+    "start", "arrival", "dequeue", "acquire", "release", "treatment-start", "treatment-end",
+    "break-start", "break-end", "resource-add", "deteriorate", "left"
+};
+
+// subject is a patient id or a LoggedResource; value is a priority, doctor or count
+struct LogRecord {
+    double time;
+    LogAction action;
+    int subject;
+    int value;
+};
+
+class EventLog {
+private:
+    mutex mtx;
+    vector<LogRecord> records;
+    bool keep = false;                 // false: only the digest (record/replay without a log file)
+    size_t count = 0;
+    uint64_t hash = 0;
+    chrono::steady_clock::time_point start;
+    atomic<bool> enabled{false};
+
+    // FNV-1a over the bytes of a value
+    void mix(uint64_t value) {
+        for (int i = 0; i < 8; ++i) {
+            hash ^= (value >> (8 * i)) & 0xFF;
+            hash *= 1099511628211ULL;
+        }
+    }
+
+public:
+    void open(bool keepRecords = true) {
+        lock_guard<mutex> lock(mtx);
+        records.clear();
+        if (keepRecords) records.reserve(1 << 16);
+        keep = keepRecords;
+        count = 0;
+        hash = 14695981039346656037ULL;
+        start = simClock.now();
+        enabled = true;
+    }
+
+    void close() { enabled = false; }
+
+    bool active() const { return enabled; }
+
+    void record(LogAction action, int subject, int value = 0) {
+        if (!enabled) return;
+        lock_guard<mutex> lock(mtx);
+        double time = chrono::duration<double>(simClock.now() - start).count();
+        uint64_t timeBits;
+        memcpy(&timeBits, &time, sizeof(timeBits));
+        mix(timeBits);
+        mix(action);
+        mix((uint64_t)(int64_t)subject);
+        mix((uint64_t)(int64_t)value);
+        count++;
+        if (keep) records.push_back({time, action, subject, value});
+    }
+
+    // Digest of every record so far, times included
+    uint64_t digest() {
+        lock_guard<mutex> lock(mtx);
+        return hash;
+    }
+
+    // Writes one "time action subject value" line per record
+    bool save(const string& path) {
+        lock_guard<mutex> lock(mtx);
+        enabled = false;
+        ofstream out(path);
+        if (!out) return false;
+        out << setprecision(9);
+        for (const LogRecord& r : records) {
+            out << r.time << ' ' << LOG_ACTION_NAMES[r.action] << ' ' << r.subject << ' ' << r.value << '\n';
+        }
+        return (bool)out;
+    }
+
+    size_t size() {
+        lock_guard<mutex> lock(mtx);
+        return count;
+    }
+};
+
+EventLog eventLog;
+
+// Semaphore Implementation
+class Semaphore {
+private:
+    atomic<int> count;              // changed under mtx; atomic so peek() needs no lock
+    int resource; // LoggedResource, or -1 if not logged
+    OrderedMutex mtx;
+    SimCondition cv;
+    deque<function<void()>> withdrawals;
+    bool cancelled = false;         // waits fail until the next reset (shutdown)
+
+    void logChange(LogAction action) {
+        if (resource >= 0) eventLog.record(action, resource);
+    }
+
+public:
+    Semaphore(int initialCount, int resource = -1)
+        : count(initialCount), resource(resource) {}
+
+    // Waits for a unit; false if cancelWaits() came first
+    bool acquire() {
+        unique_lock<OrderedMutex> lock(mtx);
+        scheduledWait(cv, lock, [this] { return count > 0 || cancelled; });
+        if (cancelled) return false;
+        --count;
+        logChange(LOG_ACQUIRE);
+        return true;
+    }
+
+    // Fails the current and future waits, so no thread stays blocked at shutdown
+    void cancelWaits() {
+        {
+            lock_guard<OrderedMutex> lock(mtx);
+            cancelled = true;
+        }
+        cv.notify_all();
+    }
+
+    void release() {
+        function<void()> onWithdrawn;
+        {
+            lock_guard<OrderedMutex> lock(mtx);
+            if (!withdrawals.empty()) {
+                // A unit waiting to go out of service takes this one instead
+                onWithdrawn = move(withdrawals.front());
+                withdrawals.pop_front();
+            } else {
+                ++count;
+                logChange(LOG_RELEASE);
+            }
+        }
+        if (onWithdrawn) {
+            onWithdrawn();
+        } else {
+            cv.notify_one();
+        }
+    }
+
+    // Takes one unit out of service (failure, maintenance). If every unit is
+    // busy, the next release is withheld instead. onWithdrawn runs once the
+    // unit is actually out of service.
+    void withdraw(function<void()> onWithdrawn) {
+        {
+            lock_guard<OrderedMutex> lock(mtx);
+            if (count == 0) {
+                withdrawals.push_back(move(onWithdrawn));
+                return;
+            }
+            --count;
+            logChange(LOG_ACQUIRE);
+        }
+        onWithdrawn();
+    }
+
+    bool try_acquire() {
+        lock_guard<OrderedMutex> lock(mtx);
+        if (count > 0) {
+            --count;
+            logChange(LOG_ACQUIRE);
+            return true;
+        }
+        return false;
+    }
+
+    int available() {
+        lock_guard<OrderedMutex> lock(mtx);
+        return count;
+    }
+
+    int peek() const { return count.load(memory_order_relaxed); }
+
+    void reset(int newCount) {
+        lock_guard<OrderedMutex> lock(mtx);
+        count = newCount;
+        withdrawals.clear();
+        cancelled = false;
+        if (resource >= 0) eventLog.record(LOG_START, resource, newCount);
+    }
+};
+
+// Timer service for the real-time mode: a single thread fires callbacks at
+// their deadlines, so long holds such as ward stays don't need a thread each
+class TimerService {
+private:
+    struct Timer {
+        chrono::steady_clock::time_point deadline;
+        unsigned long long seq;
+    };
+    struct LaterTimer {
+        bool operator()(const Timer& a, const Timer& b) const {
+            if (a.deadline == b.deadline) return a.seq > b.seq;
+            return a.deadline > b.deadline;
+        }
+    };
+
+    priority_queue<Timer, vector<Timer>, LaterTimer> timers;
+    unordered_map<unsigned long long, function<void()>> live; // timers not yet fired or cancelled
+    unsigned long long nextSeq = 1;
+    bool stopping = false;
+    OrderedMutex mtx;
+    SimCondition timerCv;
+    thread worker;
+
+    // Under the baton the thread blocks in the clock until the earliest
+    // deadline or until a new timer is scheduled
+    void runVirtual() {
+        unique_lock<OrderedMutex> lock(mtx);
+        while (!stopping) {
+            if (!timers.empty() && timers.top().deadline <= simClock.now()) {
+                auto it = live.find(timers.top().seq);
+                timers.pop();
+                if (it == live.end()) continue; // Cancelled
+                function<void()> action = move(it->second);
+                live.erase(it);
+                lock.unlock();
+                action();
+                lock.lock();
+                continue;
+            }
+            auto deadline = timers.empty() ? chrono::steady_clock::time_point::max() : timers.top().deadline;
+            lock.unlock();
+            simClock.block(&timerCv, deadline);
+            lock.lock();
+        }
+    }
+
+    void run() {
+        ActorScope actor(THREAD_TIMER);
+        if (simClock.isSerialized()) {
+            runVirtual();
+            return;
+        }
+        unique_lock<mutex> lock(mtx.raw);
+        while (!stopping) {
+            if (timers.empty()) {
+                timerCv.native.wait(lock);
+                continue;
+            }
+            auto deadline = timers.top().deadline;
+            if (timerCv.native.wait_until(lock, simClock.toWall(deadline)) == cv_status::no_timeout) continue;
+            if (timers.empty() || timers.top().deadline > simClock.now()) continue;
+
+            auto it = live.find(timers.top().seq);
+            timers.pop();
+            if (it == live.end()) continue; // Cancelled
+            function<void()> action = move(it->second);
+            live.erase(it);
+            lock.unlock();
+            action();
+            lock.lock();
+        }
+    }
+
+public:
+    void start() {
+        stopping = false;
+        simClock.spawn(THREAD_TIMER);
+        worker = thread(&TimerService::run, this);
+    }
+
+    // Stops the service; timers still pending are dropped
+    void stop() {
+        {
+            lock_guard<OrderedMutex> lock(mtx);
+            stopping = true;
+            timers = {};
+            live.clear();
+        }
+        timerCv.notify_all();
+        if (worker.joinable()) {
+            if (simClock.awaitExit(THREAD_TIMER)) {
+                worker.join();
+            } else {
+                worker.detach(); // Blocked for good (virtual clock deadlock)
+            }
+        }
+    }
+
+    // Returns an id that can be passed to cancel()
+    unsigned long long schedule(double delaySeconds, function<void()> action) {
+        unsigned long long id;
+        {
+            lock_guard<OrderedMutex> lock(mtx);
+            auto deadline = simClock.now() + simDuration(delaySeconds);
+            id = nextSeq++;
+            timers.push({deadline, id});
+            live[id] = move(action);
+        }
+        timerCv.notify_one();
+        return id;
+    }
+
+    // Cancels a pending timer; the entry is discarded when it reaches the top.
+    // Returns false if it already fired.
+    bool cancel(unsigned long long id) {
+        lock_guard<OrderedMutex> lock(mtx);
+        return live.erase(id) > 0;
+    }
+
+    size_t pending() {
+        lock_guard<OrderedMutex> lock(mtx);
+        return live.size();
+    }
+};
+
+// Shared resources
+PatientQueue patientQueue;                           // handles are patient ids
+unordered_map<int, shared_ptr<Patient>> queuedPatients;
+int patientsArrived[PRIORITY_LEVELS] = {};           // by triage priority, under queueMutex
+int patientsDeteriorated[PRIORITY_LEVELS] = {};
+int patientsAbandoned[PRIORITY_LEVELS] = {};
+OrderedMutex queueMutex;
+SimCondition cv;
+
+// Semaphores for resource management
+Semaphore doctorsAvailable(3, LOG_DOCTORS);
+Semaphore nursesAvailable(2, LOG_NURSES);
+Semaphore examRoomsAvailable(2, LOG_EXAM_ROOMS);
+Semaphore ventilatorsAvailable(1, LOG_VENTILATORS);
+
+atomic<bool> isRunning(true);
+atomic<int> nextPatientId(1);
+atomic<int> returnVisits(0);
+
+// Treatments of a threaded run inside the horizon, in simulated seconds since
+// the start; the cross-engine validation compares them with the DES
+struct ThreadedRunStats {
+    mutex mtx;
+    chrono::steady_clock::time_point start;
+    double horizonSeconds = 0;
+    vector<double> waitSeconds[PRIORITY_LEVELS]; // arrival to treatment start, by triage priority
+    long long arrived = 0;                       // arrivals and return visits inside the horizon
+    long long treated = 0;                       // treatments finished inside the horizon
+    double treatmentSeconds = 0;                 // treatment time inside the horizon
+
+    void reset(double horizon) {
+        lock_guard<mutex> lock(mtx);
+        start = simClock.now();
+        horizonSeconds = horizon;
+        for (auto& waits : waitSeconds) waits.clear();
+        arrived = treated = 0;
+        treatmentSeconds = 0;
+    }
+
+    double elapsed(chrono::steady_clock::time_point t) const {
+        return chrono::duration<double>(t - start).count();
+    }
+
+    void patientArrived(chrono::steady_clock::time_point now) {
+        lock_guard<mutex> lock(mtx);
+        if (elapsed(now) <= horizonSeconds) arrived++;
+    }
+
+    void treatmentStarted(Priority triage, chrono::steady_clock::time_point arrival, chrono::steady_clock::time_point now) {
+        lock_guard<mutex> lock(mtx);
+        if (elapsed(now) > horizonSeconds) return;
+        waitSeconds[triage].push_back(chrono::duration<double>(now - arrival).count());
+    }
+
+    // A treatment cut short at shutdown still counts its time, but not as treated
+    void treatmentFinished(chrono::steady_clock::time_point began, chrono::steady_clock::time_point now,
+                           bool completed = true) {
+        lock_guard<mutex> lock(mtx);
+        double from = elapsed(began), to = elapsed(now);
+        if (from >= horizonSeconds) return;
+        if (completed && to <= horizonSeconds) treated++;
+        treatmentSeconds += min(to, horizonSeconds) - from;
+    }
+};
+ThreadedRunStats runStats;
+
+// Shutdown of the threaded mode (shutdown = drain | abort). At the horizon the
+// arrivals stop and the periodic processes wake up and exit. Drain lets the
+// doctors finish the queue until drainSeconds later, abort stops at once. Then
+// treatments in progress are cut short and the patients never treated are
+// censored: their waits so far are only lower bounds, so they are reported
+// apart from the waits of treated patients.
+struct ShutdownStats {
+    mutex mtx;
+    long long drained = 0;                       // treatments finished after the horizon
+    long long cutShort = 0;                      // treatments stopped by an abort or the drain deadline
+    long long censored[PRIORITY_LEVELS] = {};    // never treated, by triage priority
+    double censoredWaitSeconds = 0;              // their waits up to the stop
+    double stopSeconds = 0;                      // simulated time from the horizon until the doctors stopped
+    double teardownMs = 0;                       // wall time from the horizon until every thread was joined
+
+    void reset() {
+        lock_guard<mutex> lock(mtx);
+        drained = cutShort = 0;
+        for (auto& c : censored) c = 0;
+        censoredWaitSeconds = stopSeconds = teardownMs = 0;
+    }
+
+    void censor(const Patient& patient, chrono::steady_clock::time_point now) {
+        lock_guard<mutex> lock(mtx);
+        censored[patient.triage]++;
+        censoredWaitSeconds += chrono::duration<double>(now - patient.arrivalTime).count();
+    }
+};
+ShutdownStats shutdownStats;
+StopSignal arrivalsStopped;  // raised at the horizon
+StopSignal treatmentsStopped; // raised by an abort or at the drain deadline
+StopSignal doctorsStopped;    // raised by the last doctor thread to exit
+atomic<int> doctorsActive(0);
+
+SimConfig config;
+
+// Inpatient ward shared by the doctor threads and the timer thread
+Ward ward;
+deque<shared_ptr<Patient>> boarders; // same order as the ward's boarding queue
+OrderedMutex wardMutex;
+
+// Boarding of a threaded run: transfers at the boarding cap (guarded by
+// wardMutex) and the time boarders held every exam room in service, so the ED
+// was gridlocked. The gridlock state has its own lock, taken last, because
+// rooms enter and leave service on the timer and resource threads.
+class BoardingStats {
+private:
+    OrderedMutex mtx;
+    int boarding = 0;
+    int roomsInService = 0;
+    double gridlockSeconds = 0;
+    bool gridlocked = false;
+    chrono::steady_clock::time_point since;
+
+    void update(chrono::steady_clock::time_point now) {
+        bool full = boarding > 0 && boarding >= roomsInService;
+        if (full == gridlocked) return;
+        if (gridlocked) gridlockSeconds += chrono::duration<double>(now - since).count();
+        gridlocked = full;
+        since = now;
+    }
+
+public:
+    long long transfers = 0;
+
+    void reset() {
+        lock_guard<OrderedMutex> lock(mtx);
+        transfers = 0;
+        boarding = 0;
+        roomsInService = config.examRooms;
+        gridlockSeconds = 0;
+        gridlocked = false;
+    }
+
+    // Called after each change in the number of boarders
+    void boardersChanged(size_t count, chrono::steady_clock::time_point now) {
+        lock_guard<OrderedMutex> lock(mtx);
+        boarding = (int)count;
+        update(now);
+    }
+
+    // Called when rooms are added, go out of service or come back
+    void roomsChanged(int delta, chrono::steady_clock::time_point now) {
+        lock_guard<OrderedMutex> lock(mtx);
+        roomsInService += delta;
+        update(now);
+    }
+
+    double gridlockUntil(chrono::steady_clock::time_point now) {
+        lock_guard<OrderedMutex> lock(mtx);
+        return gridlockSeconds + (gridlocked ? chrono::duration<double>(now - since).count() : 0);
+    }
+};
+BoardingStats boardingStats;
+TimerService timers;
+
+// Live view of the threaded mode for external viewers (--liveView=path). The
+// engine keeps two frames in a memory-mapped file and writes the older one on
+// each change: the frame's version is odd while it is written and even once
+// complete, and `latest` names the newest complete frame. A viewer maps the
+// file read-only, reads frames[latest & 1] and retries if the version moved,
+// so it never blocks the engine and neither side makes a system call per frame.
+const uint32_t LIVE_VIEW_MAGIC = 0x45524c56; // "VLRE"
+const uint32_t LIVE_VIEW_LAYOUT = 2;
+const int LIVE_VIEW_TREATMENTS = 64;         // doctor threads shown
+const int LIVE_VIEW_WAIT_BUCKETS = 24;       // bucket 0: under 1 s, bucket k: [2^(k-1), 2^k) s
+
+struct LiveViewData {
+    double simSeconds;
+    int32_t finished;
+    int32_t waiting[PRIORITY_LEVELS];
+    int32_t available[4];                    // LoggedResource order: doctors, nurses, rooms, ventilators
+    int32_t wardBedsFree;
+    int32_t boarders;
+    int32_t arrived;
+    int32_t treated;
+    int32_t waitHistogram[LIVE_VIEW_WAIT_BUCKETS]; // waits until treatment start
+    int32_t doctors;                         // treatment slots in use below
+    struct Treatment {
+        int32_t patient;                     // 0 = idle
+        int32_t priority;
+        double startSeconds;
+    } treatments[LIVE_VIEW_TREATMENTS];
+};
+
+struct LiveViewFrame {
+    atomic<uint64_t> version;
+    LiveViewData data;
+};
+
+struct LiveViewFile {
+    uint32_t magic;
+    uint32_t layout;
+    atomic<uint64_t> latest;                 // number of the newest complete frame, 0 = none yet
+    LiveViewFrame frames[2];
+};
+
+class LiveView {
+private:
+    atomic<bool> enabled{false};
+    mutex mtx;                               // one writer at a time; never held across a blocking call
+    LiveViewFile* file = nullptr;
+    bool mapped = false;                     // a file mapping rather than process memory
+    LiveViewData state;
+    uint64_t published = 0;
+    chrono::steady_clock::time_point startTime;
+
+    // Writes the state into the older frame and makes it the latest (mtx held)
+    void publish() {
+        state.simSeconds = chrono::duration<double>(simClock.now() - startTime).count();
+        state.available[LOG_DOCTORS] = doctorsAvailable.peek();
+        state.available[LOG_NURSES] = nursesAvailable.peek();
+        state.available[LOG_EXAM_ROOMS] = examRoomsAvailable.peek();
+        state.available[LOG_VENTILATORS] = ventilatorsAvailable.peek();
+        uint64_t n = published + 1;
+        LiveViewFrame& frame = file->frames[n & 1];
+        frame.version.store(2 * n - 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        frame.data = state;
+        frame.version.store(2 * n, memory_order_release);
+        file->latest.store(n, memory_order_release);
+        published = n;
+    }
+
+public:
+    bool open(const string& path, int doctors) {
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+        bool sized = ftruncate(fd, sizeof(LiveViewFile)) == 0;
+        void* memory = sized ? mmap(nullptr, sizeof(LiveViewFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+        ::close(fd);
+        if (memory == MAP_FAILED) return false;
+        file = (LiveViewFile*)memory;
+        mapped = true;
+        start(doctors);
+        return true;
+    }
+
+    // The same frames in process memory, for the in-process dashboard
+    void openInMemory(int doctors) {
+        file = new LiveViewFile();
+        mapped = false;
+        start(doctors);
+    }
+
+    void start(int doctors) {
+        file->magic = LIVE_VIEW_MAGIC;
+        file->layout = LIVE_VIEW_LAYOUT;
+        state = LiveViewData();
+        state.wardBedsFree = config.wardBeds;
+        state.doctors = min(doctors, LIVE_VIEW_TREATMENTS);
+        published = 0;
+        startTime = simClock.now();
+        enabled = true;
+        lock_guard<mutex> lock(mtx);
+        publish();
+    }
+
+    // Frames for readers in this process; null when the view is closed
+    const LiveViewFile* frames() const { return enabled ? file : nullptr; }
+
+    void close() {
+        if (!enabled) return;
+        lock_guard<mutex> lock(mtx);
+        state.finished = 1;
+        publish();
+        enabled = false;
+        if (mapped) {
+            munmap(file, sizeof(LiveViewFile));
+        } else {
+            delete file;
+        }
+        file = nullptr;
+    }
+
+    // Called with queueMutex held, so the counts are consistent
+    void queueChanged(const PatientQueue& queue, bool arrival = false) {
+        if (!enabled) return;
+        lock_guard<mutex> lock(mtx);
+        for (int p = 0; p < PRIORITY_LEVELS; ++p) state.waiting[p] = queue.waitingAt(Priority(p));
+        if (arrival) state.arrived++;
+        publish();
+    }
+
+    void treatmentStarted(int doctorId, int patientId, Priority priority, double waitSeconds) {
+        if (!enabled) return;
+        lock_guard<mutex> lock(mtx);
+        int bucket = waitSeconds < 1 ? 0 : min(LIVE_VIEW_WAIT_BUCKETS - 1, 1 + (int)log2(waitSeconds));
+        state.waitHistogram[bucket]++;
+        if (doctorId >= 1 && doctorId <= LIVE_VIEW_TREATMENTS) {
+            state.treatments[doctorId - 1] = {patientId, priority,
+                                              chrono::duration<double>(simClock.now() - startTime).count()};
+        }
+        publish();
+    }
+
+    void treatmentEnded(int doctorId) {
+        if (!enabled) return;
+        lock_guard<mutex> lock(mtx);
+        if (doctorId >= 1 && doctorId <= LIVE_VIEW_TREATMENTS) state.treatments[doctorId - 1].patient = 0;
+        state.treated++;
+        publish();
+    }
+
+    // Resource counts are sampled on every publish; this publishes them now
+    void resourcesChanged() {
+        if (!enabled) return;
+        lock_guard<mutex> lock(mtx);
+        publish();
+    }
+
+    // Called with wardMutex held
+    void wardChanged(const Ward& ward) {
+        if (!enabled) return;
+        lock_guard<mutex> lock(mtx);
+        state.wardBedsFree = ward.freeBeds();
+        state.boarders = ward.boarding();
+        publish();
+    }
+};
+
+LiveView liveView;
+
+// Helper function to convert priority to string
+string priorityToString(Priority priority) {
+    switch (priority) {
+        case HIGH: return "High";
+        case MEDIUM: return "Medium";
+        case LOW: return "Low";
+        default: return "Unknown";
+    }
+}
+
+// Copies the newest complete frame; retries while the engine overwrites it.
+// Returns the frame number.
+uint64_t readLiveView(const LiveViewFile* file, LiveViewData& data, long long& retries) {
+    while (true) {
+        uint64_t n = file->latest.load(memory_order_acquire);
+        const LiveViewFrame& frame = file->frames[n & 1];
+        uint64_t before = frame.version.load(memory_order_acquire);
+        if (before == 2 * n) {
+            memcpy((void*)&data, (const void*)&frame.data, sizeof(data));
+            atomic_thread_fence(memory_order_acquire);
+            if (frame.version.load(memory_order_relaxed) == before) return n;
+        }
+        retries++;
+    }
+}
+
+// Upper edge, in seconds, of the histogram bucket holding quantile q
+double waitPercentile(const LiveViewData& data, double q) {
+    long long total = 0;
+    for (int b = 0; b < LIVE_VIEW_WAIT_BUCKETS; ++b) total += data.waitHistogram[b];
+    if (total == 0) return 0;
+    long long seen = 0;
+    for (int b = 0; b < LIVE_VIEW_WAIT_BUCKETS; ++b) {
+        seen += data.waitHistogram[b];
+        if (seen >= q * total) return b == 0 ? 1 : pow(2.0, b);
+    }
+    return pow(2.0, LIVE_VIEW_WAIT_BUCKETS - 1);
+}
+
+// Frame to measure rates against: the oldest of those kept, one per simulated
+// second over the last RATE_WINDOW_SECONDS
+const double RATE_WINDOW_SECONDS = 30;
+const LiveViewData& rateBase(deque<LiveViewData>& history, const LiveViewData& data) {
+    if (history.empty() || data.simSeconds - history.back().simSeconds >= 1) history.push_back(data);
+    while (history.size() > 1 && data.simSeconds - history[1].simSeconds >= RATE_WINDOW_SECONDS) history.pop_front();
+    return history.front();
+}
+
+// Draws one screen of the live view; rates compare with an earlier frame
+string renderLiveView(const LiveViewData& data, const LiveViewData& previous, const string& title) {
+    ostringstream out;
+    double interval = data.simSeconds - previous.simSeconds;
+    out << "\033[H\033[J" << fixed << setprecision(1);
+    out << "Emergency room at t = " << data.simSeconds << " s" << title << "\n\n";
+    out << "Waiting   High " << setw(5) << data.waiting[HIGH] << "   Medium " << setw(5) << data.waiting[MEDIUM]
+        << "   Low " << setw(5) << data.waiting[LOW] << "\n";
+    out << "Free      doctors " << data.available[LOG_DOCTORS] << "   nurses " << data.available[LOG_NURSES]
+        << "   rooms " << data.available[LOG_EXAM_ROOMS] << "   ventilators " << data.available[LOG_VENTILATORS] << "\n";
+    out << "Ward      beds free " << data.wardBedsFree << "   boarding in ED " << data.boarders << "\n";
+    out << "Patients  arrived " << data.arrived << "   treated " << data.treated;
+    if (interval > 0) {
+        out << "   (" << (data.arrived - previous.arrived) * 60 / interval << " arrivals, "
+            << (data.treated - previous.treated) * 60 / interval << " treatments per simulated minute)";
+    }
+    out << "\n";
+    out << "Wait      p50 <= " << waitPercentile(data, 0.5) << " s   p90 <= " << waitPercentile(data, 0.9)
+        << " s   p99 <= " << waitPercentile(data, 0.99) << " s\n\n";
+    for (int d = 0; d < data.doctors; ++d) {
+        const LiveViewData::Treatment& t = data.treatments[d];
+        out << "Doctor " << setw(3) << d + 1 << "  ";
+        if (t.patient == 0) {
+            out << "idle\n";
+        } else {
+            out << "Patient_" << t.patient << " (" << priorityToString(Priority(t.priority)) << ") for "
+                << data.simSeconds - t.startSeconds << " s\n";
+        }
+    }
+    return out.str();
+}
+
+// Dashboard of the threaded mode (display = dashboard): redraws the live view
+// dashboardHz times a wall-clock second, whatever the event rate. It only
+// reads frames, so it takes no engine lock and is not a simulation thread.
+class Dashboard {
+private:
+    thread worker;
+    atomic<bool> stopping{false};
+
+    void run(const LiveViewFile* file) {
+        auto period = chrono::duration_cast<chrono::steady_clock::duration>(
+            chrono::duration<double>(1.0 / max(config.dashboardHz, 0.1)));
+        auto next = chrono::steady_clock::now();
+        LiveViewData data;
+        deque<LiveViewData> history;
+        long long retries = 0;
+        while (true) {
+            bool last = stopping;
+            readLiveView(file, data, retries);
+            cout << renderLiveView(data, rateBase(history, data), "") << flush;
+            if (last) break;
+            next += period;
+            this_thread::sleep_until(next);
+        }
+    }
+
+public:
+    void start(const LiveViewFile* file) {
+        stopping = false;
+        worker = thread(&Dashboard::run, this, file);
+    }
+
+    // Draws the final state and stops
+    void stop() {
+        stopping = true;
+        if (worker.joinable()) worker.join();
+    }
+};
+
+Dashboard dashboard;
+
+// Per-event lines are printed unless the dashboard replaces them
+bool eventLines() {
+    return config.display != "dashboard";
+}
+
+OrderedMutex randomMutex;
+
+// Draw from the shared rand() stream, one thread at a time
+int randomInt() {
+    lock_guard<OrderedMutex> lock(randomMutex);
+    return rand();
+}
+
+// Uniform random number in [0, 1) from the shared rand() stream
+double randomUnit() {
+    return randomInt() / (RAND_MAX + 1.0);
+}
+
+// Exponentially distributed random duration with the given mean
+double randomExponential(double mean) {
+    return -mean * log(1.0 - randomUnit());
+}
+
+// Standard normal random number (Box-Muller)
+double randomNormal() {
+    return sqrt(-2.0 * log(1.0 - randomUnit())) * cos(2.0 * M_PI * randomUnit());
+}
+
+// Function to display the current state of resources
+void displayState(const string& entity, int id, const string& name, const string& priority, const string& status) {
+    if (!eventLines()) return;
+    cout << setw(10) << entity << setw(10) << id
+         << setw(20) << name
+         << setw(15) << priority
+         << setw(20) << status
+         << setw(10) << doctorsAvailable.available()
+         << setw(10) << nursesAvailable.available()
+         << setw(10) << examRoomsAvailable.available()
+         << setw(10) << ventilatorsAvailable.available() << endl;
+}
+
+void dischargeFromWard(shared_ptr<Patient> patient);
+
+// Function to schedule the end of a ward stay on the timer thread
+void scheduleWardDischarge(shared_ptr<Patient> patient) {
+    double staySeconds = randomExponential(config.wardStayMeanDays * 24 * 60 * 60);
+    timers.schedule(staySeconds, [patient] { dischargeFromWard(patient); });
+}
+
+// Function for moving an admitted patient to the ward, boarding them in the ED,
+// or transferring them when maxBoarders are already boarding
+void admitPatient(shared_ptr<Patient> patient) {
+    bool gotBed = false, transferred = false;
+    {
+        lock_guard<OrderedMutex> lock(wardMutex);
+        if (ward.freeBeds() == 0 && config.maxBoarders > 0 && ward.boarding() >= config.maxBoarders) {
+            transferred = true;
+            boardingStats.transfers++;
+        } else {
+            gotBed = ward.admit(patient->id);
+            if (!gotBed) {
+                boarders.push_back(patient);
+                boardingStats.boardersChanged(boarders.size(), simClock.now());
+            }
+        }
+        liveView.wardChanged(ward);
+    }
+    if (transferred) {
+        examRoomsAvailable.release();
+        displayState("Ward", patient->id, patient->name, priorityToString(patient->priority), "Transferred");
+    } else if (gotBed) {
+        examRoomsAvailable.release();
+        scheduleWardDischarge(patient);
+        displayState("Ward", patient->id, patient->name, priorityToString(patient->priority), "Admitted");
+    } else {
+        displayState("Ward", patient->id, patient->name, priorityToString(patient->priority), "Boarding in ED");
+    }
+}
+
+// Function for a ward discharge; the freed bed goes to the longest boarder
+void dischargeFromWard(shared_ptr<Patient> patient) {
+    shared_ptr<Patient> boarder = nullptr;
+    {
+        lock_guard<OrderedMutex> lock(wardMutex);
+        if (ward.discharge() >= 0) {
+            boarder = boarders.front();
+            boarders.pop_front();
+            boardingStats.boardersChanged(boarders.size(), simClock.now());
+        }
+        liveView.wardChanged(ward);
+    }
+    displayState("Ward", patient->id, patient->name, priorityToString(patient->priority), "Discharged");
+    if (boarder) {
+        examRoomsAvailable.release(); // The boarder gives up their exam room
+        scheduleWardDischarge(boarder);
+        displayState("Ward", boarder->id, boarder->name, priorityToString(boarder->priority), "Admitted");
+    }
+}
+
+// Failure and maintenance process of one ventilator or exam room in the
+// real-time mode, driven entirely by timer callbacks
+struct EquipmentProcess {
+    string kind;
+    int number;
+    Semaphore* pool;
+    double mtbfHours;
+    double mttrHours;
+    double maintenanceIntervalHours;
+    double maintenanceHours;
+    bool up = true;
+    bool failureScheduled = false;
+};
+
+vector<unique_ptr<EquipmentProcess>> equipment;
+OrderedMutex equipmentMutex;
+
+void unitFailed(EquipmentProcess* unit);
+
+// Function to schedule the next failure of a unit
+void scheduleUnitFailure(EquipmentProcess* unit) {
+    if (unit->mtbfHours <= 0) return;
+    unit->failureScheduled = true;
+    timers.schedule(randomExponential(unit->mtbfHours * 3600), [unit] { unitFailed(unit); });
+}
+
+// Function for a unit coming back from repair or maintenance
+void unitBackInService(EquipmentProcess* unit) {
+    {
+        lock_guard<OrderedMutex> lock(equipmentMutex);
+        unit->up = true;
+        if (!unit->failureScheduled) scheduleUnitFailure(unit);
+    }
+    unit->pool->release();
+    if (unit->pool == &examRoomsAvailable) boardingStats.roomsChanged(1, simClock.now());
+    liveView.resourcesChanged();
+    displayState(unit->kind, unit->number, "-", "-", "Back in service");
+}
+
+// Function called once a unit is actually out of service (it may have been in use)
+void beginUnitOutage(EquipmentProcess* unit, bool failed) {
+    double hours = failed ? lognormalFromNormal(unit->mttrHours, config.repairCv, randomNormal())
+                          : unit->maintenanceHours;
+    timers.schedule(hours * 3600, [unit] { unitBackInService(unit); });
+    if (unit->pool == &examRoomsAvailable) boardingStats.roomsChanged(-1, simClock.now());
+    liveView.resourcesChanged();
+    displayState(unit->kind, unit->number, "-", "-", failed ? "Out of service" : "Maintenance");
+}
+
+// Function for a unit failure
+void unitFailed(EquipmentProcess* unit) {
+    {
+        lock_guard<OrderedMutex> lock(equipmentMutex);
+        unit->failureScheduled = false;
+        if (!unit->up) return; // Already down; the clock restarts after it returns
+        unit->up = false;
+    }
+    unit->pool->withdraw([unit] { beginUnitOutage(unit, true); });
+}
+
+// Function for the start of a scheduled maintenance window
+void unitMaintenance(EquipmentProcess* unit) {
+    timers.schedule(unit->maintenanceIntervalHours * 3600, [unit] { unitMaintenance(unit); });
+    {
+        lock_guard<OrderedMutex> lock(equipmentMutex);
+        if (!unit->up) return; // Skip the window while the unit is under repair
+        unit->up = false;
+    }
+    unit->pool->withdraw([unit] { beginUnitOutage(unit, false); });
+}
+
+// Function to start the failure and maintenance processes of all units
+void startEquipmentProcesses() {
+    equipment.clear();
+    for (int i = 0; i < config.ventilators; ++i) {
+        equipment.emplace_back(new EquipmentProcess{"Ventilator", i + 1, &ventilatorsAvailable,
+            config.ventilatorMtbfHours, config.ventilatorMttrHours,
+            config.ventilatorMaintenanceIntervalHours, config.ventilatorMaintenanceHours});
+    }
+    for (int i = 0; i < config.examRooms; ++i) {
+        equipment.emplace_back(new EquipmentProcess{"Room", i + 1, &examRoomsAvailable,
+            config.roomMtbfHours, config.roomMttrHours,
+            config.roomMaintenanceIntervalHours, config.roomMaintenanceHours});
+    }
+
+    lock_guard<OrderedMutex> lock(equipmentMutex);
+    for (auto& unit : equipment) {
+        EquipmentProcess* u = unit.get();
+        scheduleUnitFailure(u);
+        if (u->maintenanceIntervalHours > 0) {
+            int count = u->pool == &ventilatorsAvailable ? config.ventilators : config.examRooms;
+            double first = u->maintenanceIntervalHours * 3600 * u->number / count;
+            timers.schedule(first, [u] { unitMaintenance(u); });
+        }
+    }
+}
+
+void scheduleReturnVisit(shared_ptr<Patient> patient);
+
+// Function for treating a patient
+void treatPatient(int doctorId) {
+    ActorScope actor(THREAD_DOCTOR_BASE + doctorId);
+    while (true) {
+        shared_ptr<Patient> currentPatient = nullptr;
+        {
+            unique_lock<OrderedMutex> lock(queueMutex);
+            scheduledWait(cv, lock, [] { return !patientQueue.empty() || !isRunning; });
+
+            // After the horizon the doctors drain the queue until treatments are stopped
+            if (!isRunning && (patientQueue.empty() || treatmentsStopped.isRaised())) break;
+
+            int patientId = patientQueue.top().handle;
+            patientQueue.pop();
+            liveView.queueChanged(patientQueue);
+            currentPatient = queuedPatients[patientId];
+            queuedPatients.erase(patientId);
+            eventLog.record(LOG_DEQUEUE, patientId, doctorId);
+        }
+        currentPatient->waitSeconds =
+            chrono::duration<double>(simClock.now() - currentPatient->arrivalTime).count();
+        if (currentPatient->deteriorationTimer != 0) timers.cancel(currentPatient->deteriorationTimer);
+        if (currentPatient->abandonTimer != 0) timers.cancel(currentPatient->abandonTimer);
+
+        // Acquire a doctor, a nurse and an exam room; stopping the treatments cancels the waits
+        bool gotDoctor = doctorsAvailable.acquire();
+        bool gotNurse = gotDoctor && nursesAvailable.acquire();
+        bool gotRoom = gotNurse && examRoomsAvailable.acquire();
+        if (!gotRoom) {
+            if (gotNurse) nursesAvailable.release();
+            if (gotDoctor) doctorsAvailable.release();
+            shutdownStats.censor(*currentPatient, simClock.now());
+            break;
+        }
+
+        // Try to allocate ventilator if needed
+        bool ventilatorAllocated = false;
+        if (currentPatient->priority == HIGH) {
+            if (ventilatorsAvailable.try_acquire()) {
+                ventilatorAllocated = true;
+            } else {
+                if (eventLines()) cout << "Ventilator unavailable for " << currentPatient->name << endl;
+            }
+        }
+
+        eventLog.record(LOG_TREATMENT_START, currentPatient->id, doctorId);
+        auto treatmentStart = simClock.now();
+        runStats.treatmentStarted(currentPatient->triage, currentPatient->arrivalTime, treatmentStart);
+        liveView.treatmentStarted(doctorId, currentPatient->id, currentPatient->priority,
+                                  chrono::duration<double>(treatmentStart - currentPatient->arrivalTime).count());
+
+        // Display treatment activity
+        displayState("Doctor", doctorId, currentPatient->name, priorityToString(currentPatient->priority), "Treating...");
+
+        bool completed = treatmentsStopped.sleepFor(config.treatmentSeconds); // Simulating treatment time
+
+        // Release resources
+        if (ventilatorAllocated) {
+            ventilatorsAvailable.release();
+        }
+        doctorsAvailable.release();  // Release the doctor
+        nursesAvailable.release();   // Release the nurse
+        eventLog.record(LOG_TREATMENT_END, currentPatient->id, doctorId);
+        runStats.treatmentFinished(treatmentStart, simClock.now(), completed);
+        liveView.treatmentEnded(doctorId);
+        if (!completed) {
+            examRoomsAvailable.release();
+            lock_guard<mutex> lock(shutdownStats.mtx);
+            shutdownStats.cutShort++;
+            continue;
+        }
+        if (!isRunning) {
+            lock_guard<mutex> lock(shutdownStats.mtx);
+            shutdownStats.drained++;
+        }
+
+        // Display completion activity
+        displayState("Doctor", doctorId, currentPatient->name, priorityToString(currentPatient->priority), "Finished");
+
+        // Disposition: admitted patients keep the exam room until a ward bed is free
+        if (randomUnit() < config.admitProbability[currentPatient->priority]) {
+            admitPatient(currentPatient);
+        } else {
+            examRoomsAvailable.release(); // Release the exam room
+            scheduleReturnVisit(currentPatient);
+        }
+    }
+    if (--doctorsActive == 0) doctorsStopped.raise();
+}
+
+void deteriorate(int patientId);
+
+// Function to start the deterioration clock of a waiting patient (call with queueMutex held)
+void scheduleDeterioration(shared_ptr<Patient> patient) {
+    double meanMinutes = config.deteriorationMeanMinutes[patient->priority];
+    if (patient->priority == HIGH || meanMinutes <= 0) return;
+    int id = patient->id;
+    patient->deteriorationTimer = timers.schedule(randomExponential(meanMinutes * 60), [id] { deteriorate(id); });
+}
+
+void abandon(int patientId);
+
+// Function to start the patience clock of a waiting patient (call with queueMutex held)
+void scheduleAbandonment(shared_ptr<Patient> patient) {
+    double meanMinutes = config.abandonMeanMinutes[patient->priority];
+    patient->abandonTimer = 0;
+    if (meanMinutes <= 0) return;
+    int id = patient->id;
+    patient->abandonTimer = timers.schedule(randomExponential(meanMinutes * 60), [id] { abandon(id); });
+}
+
+// Function for a waiting patient whose condition worsens by one priority level
+void deteriorate(int patientId) {
+    lock_guard<OrderedMutex> lock(queueMutex);
+    if (!patientQueue.contains(patientId)) return; // Treatment already started
+    shared_ptr<Patient> patient = queuedPatients[patientId];
+    if (patient->priority == patient->triage) patientsDeteriorated[patient->triage]++;
+    patient->priority = Priority(patient->priority - 1);
+    patientQueue.reprioritize(patientId, patient->priority);
+    liveView.queueChanged(patientQueue);
+    eventLog.record(LOG_DETERIORATE, patientId, patient->priority);
+    displayState("Patient", patient->id, patient->name, priorityToString(patient->priority), "Deteriorated");
+    scheduleDeterioration(patient);
+    // Patience is drawn again at the new priority's rate
+    if (patient->abandonTimer != 0) timers.cancel(patient->abandonTimer);
+    scheduleAbandonment(patient);
+}
+
+// Function for a waiting patient who runs out of patience and leaves without being seen
+void abandon(int patientId) {
+    lock_guard<OrderedMutex> lock(queueMutex);
+    if (!patientQueue.contains(patientId)) return; // Treatment already started
+    shared_ptr<Patient> patient = queuedPatients[patientId];
+    if (patient->deteriorationTimer != 0) timers.cancel(patient->deteriorationTimer);
+    patientQueue.remove(patientId);
+    liveView.queueChanged(patientQueue);
+    queuedPatients.erase(patientId);
+    eventLog.record(LOG_LEFT, patientId);
+    patientsAbandoned[patient->triage]++;
+    displayState("Patient", patient->id, patient->name, priorityToString(patient->priority), "Left");
+}
+
+void addPatient(string name, Priority priority, const string& status = "Arrived");
+
+// Function to decide whether a discharged patient will come back to the ED later
+void scheduleReturnVisit(shared_ptr<Patient> patient) {
+    if (randomUnit() >= returnVisitProbability(config, patient->triage, patient->waitSeconds)) return;
+    double delaySeconds = randomExponential(config.returnDelayMeanDays * 24 * 60 * 60);
+    string name = patient->name;
+    Priority triage = patient->triage;
+    timers.schedule(delaySeconds, [name, triage] {
+        if (!isRunning) return;
+        returnVisits++;
+        addPatient(name, triage, "Returned");
+    });
+}
+
+// Function for adding patients to the queue; an empty name means a new patient
+void addPatient(string name, Priority priority, const string& status) {
+    {
+        lock_guard<OrderedMutex> lock(queueMutex);
+        int id = nextPatientId++; // Under queueMutex, so ids follow the queue order
+        if (name.empty()) name = "Patient_" + to_string(id);
+        auto newPatient = make_shared<Patient>(id, name, priority, simClock.now());
+        patientQueue.push(id, id, priority);
+        liveView.queueChanged(patientQueue, true);
+        queuedPatients[id] = newPatient;
+        eventLog.record(LOG_ARRIVAL, id, priority);
+        patientsArrived[priority]++;
+        runStats.patientArrived(newPatient->arrivalTime);
+        scheduleDeterioration(newPatient);
+        scheduleAbandonment(newPatient);
+
+        // Display patient arrival
+        displayState("Patient", id, name, priorityToString(priority), status);
+    }
+    cv.notify_one();
+}
+
+// Function to simulate patient arrivals
+void patientArrival() {
+    ActorScope actor(THREAD_ARRIVALS);
+    int arrivalSpread = config.arrivalMaxSeconds - config.arrivalMinSeconds + 1;
+    auto next = simClock.now();
+    while (isRunning) {
+        next += simDuration(randomInt() % arrivalSpread + config.arrivalMinSeconds); // Random patient arrival time
+        if (!arrivalsStopped.sleepUntil(next)) break;
+        addPatient("", Priority(randomInt() % 3));
+    }
+}
+
+// Function to simulate dynamic resource generation (shift changes or emergencies)
+void dynamicResourceGeneration() {
+    ActorScope actor(THREAD_RESOURCES);
+    if (!config.dynamicResources) return;
+    auto next = simClock.now();
+    while (isRunning) {
+        next += simDuration(config.resourceIntervalSeconds); // Simulate resource generation every 10 seconds
+        if (!arrivalsStopped.sleepUntil(next)) break;
+        {
+            lock_guard<OrderedMutex> lock(queueMutex);
+            int newDoctors = randomInt() % 2; // Randomly add 0 or 1 doctor
+            int newNurses = randomInt() % 2;  // Randomly add 0 or 1 nurse
+            int newExamRooms = randomInt() % 2; // Randomly add 0 or 1 exam room
+            if (newDoctors > 0) eventLog.record(LOG_RESOURCE_ADD, LOG_DOCTORS, newDoctors);
+            if (newNurses > 0) eventLog.record(LOG_RESOURCE_ADD, LOG_NURSES, newNurses);
+            if (newExamRooms > 0) eventLog.record(LOG_RESOURCE_ADD, LOG_EXAM_ROOMS, newExamRooms);
+            for (int i = 0; i < newDoctors; ++i) doctorsAvailable.release();
+            for (int i = 0; i < newNurses; ++i) nursesAvailable.release();
+            for (int i = 0; i < newExamRooms; ++i) examRoomsAvailable.release();
+            if (newExamRooms > 0) boardingStats.roomsChanged(newExamRooms, simClock.now());
+            liveView.resourcesChanged();
+
+            if ((newDoctors > 0 || newNurses > 0 || newExamRooms > 0) && eventLines()) {
+                cout << "Additional Resources: " << newDoctors << " doctor(s), " 
+                     << newNurses << " nurse(s), and " << newExamRooms 
+                     << " exam room(s) added due to shift changes or emergencies." << endl;
+            }
+        }
+    }
+}
+
+// Function to simulate staff behavior, including fatigue and breaks
+void staffBehavior() {
+    ActorScope actor(THREAD_STAFF);
+    if (!config.staffBreaks) return;
+    auto next = simClock.now();
+    while (isRunning) {
+        next += simDuration(config.breakIntervalSeconds); // Simulate break time for staff every 20 seconds
+        if (!arrivalsStopped.sleepUntil(next)) break;
+        {
+            lock_guard<OrderedMutex> lock(queueMutex);
+            if (doctorsAvailable.try_acquire()) {
+                eventLog.record(LOG_BREAK_START, LOG_DOCTORS);
+                liveView.resourcesChanged();
+                // Simulate a doctor taking a break and temporarily reducing availability
+                next = simClock.now() + simDuration(config.breakDurationSeconds); // Break duration
+                arrivalsStopped.sleepUntil(next); // Cut short at the horizon
+                eventLog.record(LOG_BREAK_END, LOG_DOCTORS);
+                doctorsAvailable.release();
+                liveView.resourcesChanged();
+                if (eventLines()) cout << "A doctor has returned from a break, increasing availability." << endl;
+            }
+        }
+    }
+}
+
+// Function to print the summary of a discrete-event run
+void printDesReport(const DiscreteEventSimulation& sim, double cpuSeconds) {
+    const DiscreteEventSimulation::Stats& s = sim.statistics();
+    SimTime end = sim.currentTime();
+
+    cout << fixed << setprecision(2);
+    cout << "Simulated " << ticksToSeconds(end) / 3600.0 << " hours in " << cpuSeconds << " s ("
+         << s.eventsProcessed << " events)" << endl;
+    cout << setw(10) << "Priority" << setw(10) << "Arrived" << setw(10) << "Treated"
+         << setw(15) << "Mean wait(s)" << setw(15) << "Max wait(s)" << setw(10) << "Admitted"
+         << setw(15) << "Deteriorated" << endl;
+    long long deteriorated = 0, eligible = 0;
+    for (int p = 0; p < PRIORITY_LEVELS; ++p) {
+        double meanWait = s.treated[p] > 0 ? s.waitSeconds[p] / s.treated[p] : 0.0;
+        cout << setw(10) << priorityToString(Priority(p)) << setw(10) << s.arrived[p] << setw(10) << s.treated[p]
+             << setw(15) << meanWait << setw(15) << s.maxWaitSeconds[p] << setw(10) << s.admitted[p]
+             << setw(15) << s.deteriorated[p] << endl;
+        if (p != HIGH) {
+            deteriorated += s.deteriorated[p];
+            eligible += s.arrived[p];
+        }
+    }
+    if (deteriorated > 0) {
+        cout << "Deterioration while waiting: " << deteriorated << " of " << eligible << " Medium/Low patients ("
+             << 100.0 * deteriorated / eligible << "%), " << s.escalations << " escalations";
+        if (s.deterioratedTreated > 0) {
+            cout << ", their mean wait " << s.deterioratedWaitSeconds / s.deterioratedTreated << " s";
+        }
+        cout << endl;
+    }
+    long long returns = s.returnVisits[HIGH] + s.returnVisits[MEDIUM] + s.returnVisits[LOW];
+    if (s.returnsScheduled > 0) {
+        long long arrivals = s.arrived[HIGH] + s.arrived[MEDIUM] + s.arrived[LOW];
+        cout << "Return visits: " << returns << " (" << 100.0 * returns / max(arrivals, 1LL) << "% of arrivals; High "
+             << s.returnVisits[HIGH] << ", Medium " << s.returnVisits[MEDIUM] << ", Low " << s.returnVisits[LOW]
+             << "), " << s.returnsScheduled - returns << " still due after the horizon" << endl;
+    }
+    long long abandoned = s.abandoned[HIGH] + s.abandoned[MEDIUM] + s.abandoned[LOW];
+    if (abandoned > 0) {
+        cout << "Left without being seen: " << abandoned << " (High " << s.abandoned[HIGH] << ", Medium "
+             << s.abandoned[MEDIUM] << ", Low " << s.abandoned[LOW] << "), mean wait before leaving "
+             << s.abandonWaitSeconds / abandoned << " s" << endl;
+    }
+    const CancellableEventList<DiscreteEventSimulation::Event>::Metrics& fel = sim.eventListStatistics();
+    cout << "Event list: " << fel.pops << " pops, " << fel.cancellations << " cancellations, " << fel.wastedPops
+         << " wasted pops (" << 100.0 * fel.wastedPops / max(fel.pops + fel.wastedPops, 1LL) << "%), "
+         << fel.compactions << " compactions dropping " << fel.compactedTombstones << " tombstones, "
+         << sim.pendingEvents() << " pending at the end" << endl;
+    if (HugePageArena::mode != HUGE_PAGES_OFF) {
+        const HugePageArena::Metrics& arena = HugePageArena::metrics;
+        cout << "Huge pages: " << arena.liveBytes / 1048576.0 << " MB in the arena, " << arena.explicitBytes / 1048576.0
+             << " MB mapped on reserved pages, " << arena.advisedBytes / 1048576.0 << " MB advised as transparent, "
+             << anonHugePagesMb() << " MB backed by transparent huge pages";
+        if (arena.explicitFallbacks > 0) cout << ", " << arena.explicitFallbacks << " reserved-page fallbacks";
+        cout << endl;
+    }
+    cout << "Ventilator shortages: " << s.ventilatorShortages << " (" << s.ventilatorShortagesDuringOutage
+         << " while a ventilator was out of service)" << endl;
+    const char* kindNames[2] = {"Ventilators", "Exam rooms"};
+    int installed[2] = {sim.configuration().ventilators, sim.configuration().examRooms};
+    for (int kind = 0; kind < 2; ++kind) {
+        if (s.failures[kind] == 0 && s.maintenanceWindows[kind] == 0) continue;
+        double meanUp = s.unitsInService[kind].mean(end);
+        cout << kindNames[kind] << ": " << s.failures[kind] << " failures, " << s.maintenanceWindows[kind]
+             << " maintenance windows, mean in service " << meanUp << " of " << installed[kind]
+             << " (availability " << 100.0 * meanUp / max(installed[kind], 1) << "%)" << endl;
+    }
+    cout << "Mean queue length: " << s.queueLength.mean(end) << ", still waiting: " << sim.waitingPatients()
+         << ", in treatment: " << sim.patientsIn(IN_TREATMENT) << endl;
+    cout << "Ward: mean occupied beds " << s.wardOccupancy.mean(end) << ", discharges " << s.wardDischarges << endl;
+    cout << "Boarding: " << s.boarded << " patients boarded, mean boarders in ED " << s.edBoarders.mean(end)
+         << ", still boarding " << sim.boardingPatients();
+    if (s.boarded - sim.boardingPatients() > 0) {
+        cout << ", mean boarding time " << s.boardingSeconds / (s.boarded - sim.boardingPatients()) / 3600.0
+             << " h, max " << s.maxBoardingSeconds / 3600.0 << " h";
+    }
+    cout << endl;
+    double gridlockHours = s.gridlock.mean(end) * ticksToSeconds(end) / 3600.0;
+    if (s.boarded > 0) {
+        cout << "ED gridlocked (boarders in every exam room): " << gridlockHours << " h, "
+             << 100.0 * s.gridlock.mean(end) << "% of the run" << endl;
+    }
+    if (s.transfers > 0) {
+        cout << "Transferred to another hospital: " << s.transfers;
+        if (s.boardingFullTransfers > 0) cout << " (" << s.boardingFullTransfers << " at the boarding cap)";
+        cout << endl;
+    }
+    if (sim.patientsIn(WAITING_VENTILATOR) > 0) {
+        cout << "Holding a team for a ventilator at the end: " << sim.patientsIn(WAITING_VENTILATOR) << endl;
+    }
+    cout << defaultfloat;
+}
+
+// Function to read --scenario=<file> and --key=value options from the command line
+bool parseArguments(SimConfig& cfg, int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (arg.compare(0, 2, "--") != 0 || eq == string::npos) {
+            cerr << "Usage: " << argv[0] << " [--scenario=<file>] [--key=value ...]" << endl;
+            return false;
+        }
+        string key = arg.substr(2, eq - 2);
+        string value = arg.substr(eq + 1);
+        if (key == "scenario") {
+            if (!loadScenario(cfg, value)) return false;
+        } else if (!applyOption(cfg, key, value)) {
+            cerr << "Unknown option --" << key << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Function to run the model in virtual time
+void runDiscreteEvent() {
+    unsigned int seed = config.seed != 0 ? config.seed : (unsigned int)time(0);
+    cout << "Hospital Emergency Room Simulation (discrete-event, seed " << seed << ")..." << endl;
+
+    auto start = chrono::steady_clock::now();
+    DiscreteEventSimulation sim(config, seed);
+    sim.run();
+    double cpuSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    printDesReport(sim, cpuSeconds);
+}
+
+// CPUs of each NUMA node this process may run on, read from sysfs at startup.
+// Without sysfs (or outside Linux) every allowed CPU is one node.
+struct CpuTopology {
+    vector<vector<int>> nodeCpus;
+
+    // Parses a kernel CPU list such as "0-3,8-11"
+    static vector<int> parseCpuList(const string& text) {
+        vector<int> cpus;
+        stringstream list(text);
+        string range;
+        while (getline(list, range, ',')) {
+            if (range.empty() || !isdigit((unsigned char)range[0])) continue;
+            size_t dash = range.find('-');
+            int first = stoi(range.substr(0, dash));
+            int last = dash == string::npos ? first : stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+        }
+        return cpus;
+    }
+
+    static CpuTopology detect() {
+        CpuTopology topology;
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        bool masked = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+        for (int node = 0;; ++node) {
+            ifstream file("/sys/devices/system/node/node" + to_string(node) + "/cpulist");
+            if (!file) break;
+            string text;
+            getline(file, text);
+            vector<int> cpus;
+            for (int cpu : parseCpuList(text)) {
+                if (!masked || CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+            }
+            if (!cpus.empty()) topology.nodeCpus.push_back(cpus);
+        }
+        if (topology.nodeCpus.empty()) {
+            vector<int> cpus;
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (masked && CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+            }
+            if (cpus.empty()) cpus.push_back(0);
+            topology.nodeCpus.push_back(cpus);
+        }
+        return topology;
+    }
+
+    int cpuCount() const {
+        int count = 0;
+        for (const auto& cpus : nodeCpus) count += (int)cpus.size();
+        return count;
+    }
+
+    // Worker w goes to node w mod nodes, so the workers spread over the
+    // sockets, then to the next core of that node
+    void place(int worker, int& node, int& cpu) const {
+        node = worker % (int)nodeCpus.size();
+        const vector<int>& cpus = nodeCpus[node];
+        cpu = cpus[(worker / nodeCpus.size()) % cpus.size()];
+    }
+};
+
+// Pins the calling thread to one CPU; returns false if the kernel refuses
+bool pinCurrentThread(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+// Summary of one discrete-event replication
+struct ReplicationSummary {
+    double meanWait[PRIORITY_LEVELS] = {};
+    long long arrived = 0;
+    long long treated = 0;
+    long long events = 0;
+};
+
+// Runs one replication on a worker's engine, reusing its memory from the last one
+ReplicationSummary runReplication(Simulation& sim, unsigned int seed) {
+    sim.reset(seed);
+    const SimulationResults& r = sim.run();
+    ReplicationSummary summary;
+    for (int p = 0; p < PRIORITY_LEVELS; ++p) {
+        summary.meanWait[p] = r.meanWaitSeconds[p];
+        summary.arrived += r.arrived[p];
+        summary.treated += r.treated[p];
+    }
+    summary.events = r.eventsProcessed;
+    return summary;
+}
+
+// Engine of one replication worker, or null after printing why the
+// configuration was rejected
+unique_ptr<Simulation> makeReplicationEngine() {
+    string error;
+    unique_ptr<Simulation> sim = Simulation::create(config, error);
+    if (!sim) cerr << "Invalid configuration: " + error + "\n"; // one write, the workers may fail together
+    return sim;
+}
+
+// Prints the mean and 95% confidence half-width across replications of the
+// waits by priority and the treatments
+void printReplicationSummaries(const vector<ReplicationSummary>& results) {
+    auto summarize = [&](function<double(const ReplicationSummary&)> metric, double& mean, double& halfWidth) {
+        double sum = 0, sumSquares = 0;
+        for (const ReplicationSummary& r : results) {
+            double x = metric(r);
+            sum += x;
+            sumSquares += x * x;
+        }
+        double n = (double)results.size();
+        mean = n > 0 ? sum / n : 0;
+        double variance = n > 1 ? max(0.0, (sumSquares - n * mean * mean) / (n - 1)) : 0;
+        halfWidth = n > 0 ? 1.96 * sqrt(variance / n) : 0;
+    };
+
+    cout << fixed << setprecision(2);
+    double mean, halfWidth;
+    for (int p = 0; p < PRIORITY_LEVELS; ++p) {
+        summarize([p](const ReplicationSummary& r) { return r.meanWait[p]; }, mean, halfWidth);
+        cout << setw(10) << priorityToString(Priority(p)) << " mean wait " << setw(12) << mean << " s  +/- "
+             << halfWidth << endl;
+    }
+    summarize([](const ReplicationSummary& r) { return (double)r.treated; }, mean, halfWidth);
+    cout << "Treated per replication " << mean << " +/- " << halfWidth << endl;
+    cout << defaultfloat;
+}
+
+// Runs the replications on workerThreads threads. Each worker builds its own
+// engine and reuses it for every replication it claims: when the worker is
+// pinned, the patient components, event list, queues and statistics are first
+// touched on its core, so the kernel places them on that core's NUMA node and
+// they stay there. Replication r always uses seed + r, whatever the thread count.
+// False if the workers could not build their engines.
+bool runReplications(const CpuTopology& topology, int workers, bool pin, unsigned int seed, int replications,
+                     vector<ReplicationSummary>& results, int& pinned) {
+    results.assign(replications, ReplicationSummary());
+    atomic<int> next(0);
+    atomic<int> pinnedWorkers(0);
+    atomic<bool> failed(false);
+    vector<thread> threads;
+    for (int w = 0; w < workers; ++w) {
+        threads.emplace_back([&, w] {
+            if (pin) {
+                int node, cpu;
+                topology.place(w, node, cpu);
+                if (pinCurrentThread(cpu)) pinnedWorkers++;
+            }
+            unique_ptr<Simulation> sim = makeReplicationEngine();
+            if (!sim) {
+                failed = true;
+                return;
+            }
+            for (int r = next++; r < replications; r = next++) {
+                results[r] = runReplication(*sim, seed + r);
+            }
+        });
+    }
+    for (thread& t : threads) t.join();
+    pinned = pinnedWorkers;
+    return !failed;
+}
+
+int replicationWorkers(const CpuTopology& topology) {
+    return config.workerThreads > 0 ? config.workerThreads : topology.cpuCount();
+}
+
+void printTopology(const CpuTopology& topology) {
+    cout << "Topology: " << topology.nodeCpus.size() << " NUMA node(s)";
+    for (size_t node = 0; node < topology.nodeCpus.size(); ++node) {
+        cout << (node == 0 ? ": " : ", ") << "node " << node << " has " << topology.nodeCpus[node].size() << " CPU(s)";
+    }
+    cout << endl;
+}
+
+// Function to run independent discrete-event replications in parallel; false
+// if the engines could not be built
+bool runParallelReplications() {
+    unsigned int seed = config.seed != 0 ? config.seed : (unsigned int)time(0);
+    int replications = max(config.replications, 1);
+    CpuTopology topology = CpuTopology::detect();
+    int workers = replicationWorkers(topology);
+    printTopology(topology);
+    cout << "Running " << replications << " discrete-event replications (seed " << seed << ") on " << workers
+         << " worker(s)" << (config.pinThreads ? ", pinned" : "") << "..." << endl;
+
+    int pinned = 0;
+    auto start = chrono::steady_clock::now();
+    vector<ReplicationSummary> results;
+    if (!runReplications(topology, workers, config.pinThreads, seed, replications, results, pinned)) return false;
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (config.pinThreads && pinned < workers) cout << "Note: only " << pinned << " worker(s) could be pinned" << endl;
+
+    long long events = 0;
+    for (const ReplicationSummary& r : results) events += r.events;
+    cout << fixed << setprecision(2) << "Ran in " << seconds << " s (" << replications / max(seconds, 1e-9)
+         << " replications/s, " << events / max(seconds, 1e-9) / 1e6 << " M events/s)" << defaultfloat << endl;
+    printReplicationSummaries(results);
+    return true;
+}
+
+// Function to compare unpinned and pinned replication throughput; each
+// configuration runs the same replications benchRounds times, alternating.
+// False if the engines could not be built.
+bool runPinningBenchmark() {
+    unsigned int seed = config.seed != 0 ? config.seed : 12345;
+    int replications = max(config.replications, 1);
+    CpuTopology topology = CpuTopology::detect();
+    int workers = replicationWorkers(topology);
+    printTopology(topology);
+    cout << "Pinning benchmark: " << replications << " replications on " << workers << " worker(s), "
+         << config.benchRounds << " round(s) each" << endl;
+
+    double best[2] = {1e300, 1e300};
+    long long events = 0;
+    for (int round = 0; round < config.benchRounds; ++round) {
+        for (int pin = 0; pin < 2; ++pin) {
+            int pinned = 0;
+            auto start = chrono::steady_clock::now();
+            vector<ReplicationSummary> results;
+            if (!runReplications(topology, workers, pin, seed, replications, results, pinned)) return false;
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            best[pin] = min(best[pin], seconds);
+            events = 0;
+            for (const ReplicationSummary& r : results) events += r.events;
+        }
+    }
+    cout << fixed << setprecision(2);
+    const char* names[2] = {"unpinned", "pinned"};
+    for (int pin = 0; pin < 2; ++pin) {
+        cout << setw(10) << names[pin] << setw(10) << best[pin] << " s" << setw(12)
+             << replications / best[pin] << " replications/s" << setw(10) << events / best[pin] / 1e6
+             << " M events/s" << endl;
+    }
+    cout << "Pinned speedup: " << best[0] / best[1] << "x (best of " << config.benchRounds << ")" << endl;
+    cout << defaultfloat;
+    return true;
+}
+
+// Danger levels of the splitting mode: splittingLevels, or one per ventilator
+vector<int> splittingLevels() {
+    vector<int> levels;
+    if (config.splittingLevels.empty()) {
+        for (int level = 1; level <= config.ventilators; ++level) levels.push_back(level);
+        return levels;
+    }
+    stringstream list(config.splittingLevels);
+    string item;
+    while (getline(list, item, ',')) {
+        int level = stoi(item);
+        if (level <= 0 || (!levels.empty() && level <= levels.back())) return {};
+        levels.push_back(level);
+    }
+    return levels;
+}
+
+// Function to estimate the probability of a ventilator shortage (a HIGH
+// patient finding no ventilator) within the horizon by fixed-effort multilevel
+// splitting. The importance of a state is ventilatorPressure(). Stage k starts
+// splittingEffort trajectories from the states in which stage k-1's
+// trajectories first reached level k. Each trajectory is a copy of its entry
+// state with a fresh seed, taken round-robin. It runs until it reaches level
+// k+1, a shortage or the horizon, and the last stage runs until a shortage. A
+// trajectory that has had a shortage is a hit in every later stage. The
+// estimate is the product of the stage hit ratios. Effort is spent only on
+// trajectories already close to a shortage, not on the many quiet runs that
+// plain Monte Carlo mostly simulates. With splittingCompare, returns false if
+// plain Monte Carlo on the same event budget disagrees at validationAlpha.
+bool runImportanceSplitting() {
+    unsigned int seed = config.seed != 0 ? config.seed : (unsigned int)time(0);
+    int effort = max(config.splittingEffort, 1);
+    vector<int> levels;
+    try {
+        levels = splittingLevels();
+    } catch (const exception&) {
+        levels.clear();
+    }
+    if (levels.empty() && !config.splittingLevels.empty()) {
+        cerr << "splittingLevels must be increasing positive integers: " << config.splittingLevels << endl;
+        return false;
+    }
+    cout << "Importance splitting: P(ventilator shortage within " << config.horizonSeconds / 3600.0 << " h), seed "
+         << seed << ", " << effort << " trajectories per stage" << endl;
+
+    mt19937 seeds(seed);
+    DiscreteEventSimulation root(config, seeds());
+    root.start();
+    vector<unique_ptr<DiscreteEventSimulation>> entries;
+    entries.emplace_back(new DiscreteEventSimulation(root));
+
+    double estimate = 1, relativeVariance = 0;
+    long long events = 0;
+    auto start = chrono::steady_clock::now();
+    cout << setw(10) << "Stage" << setw(22) << "Target" << setw(10) << "Hits" << setw(14) << "Ratio" << endl;
+    for (size_t stage = 0; stage <= levels.size(); ++stage) {
+        bool last = stage == levels.size();
+        vector<unique_ptr<DiscreteEventSimulation>> hits;
+        int hitCount = 0;
+        for (int i = 0; i < effort; ++i) {
+            unique_ptr<DiscreteEventSimulation> trial(new DiscreteEventSimulation(*entries[i % entries.size()]));
+            DiscreteEventSimulation& t = *trial;
+            t.reseed(seeds());
+            long long eventsBefore = t.statistics().eventsProcessed;
+            // The root starts without shortages, so any shortage is the event estimated
+            auto shortage = [&] { return t.statistics().ventilatorShortages > 0; };
+            bool hit = shortage() ||
+                       (last ? t.runUntil(shortage)
+                             : t.ventilatorPressure() >= levels[stage] ||
+                                   t.runUntil([&] { return t.ventilatorPressure() >= levels[stage] || shortage(); }));
+            events += t.statistics().eventsProcessed - eventsBefore;
+            if (!hit) continue;
+            hitCount++;
+            if (!last) hits.push_back(move(trial));
+        }
+        double ratio = (double)hitCount / effort;
+        cout << setw(10) << stage + 1 << setw(22)
+             << (last ? string("shortage") : "pressure >= " + to_string(levels[stage])) << setw(10) << hitCount
+             << setw(14) << ratio << endl;
+        estimate *= ratio;
+        if (hitCount == 0) {
+            cout << "No trajectory got through this stage; raise splittingEffort or add intermediate levels" << endl;
+            break;
+        }
+        relativeVariance += (1 - ratio) / (effort * ratio);
+        if (!last) entries = move(hits);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    double relativeError = sqrt(relativeVariance);
+    cout << "Estimate " << estimate << " (relative error ~" << relativeError << ", 95% interval "
+         << max(0.0, estimate * (1 - 1.96 * relativeError)) << " - " << estimate * (1 + 1.96 * relativeError) << "), "
+         << events << " events in " << seconds << " s" << endl;
+    if (!config.splittingCompare) return true;
+
+    // Plain Monte Carlo with the same number of events
+    DiscreteEventSimulation sim(config, seed);
+    long long runs = 0, shortages = 0, crudeEvents = 0;
+    while (crudeEvents < events) {
+        sim.reset(seeds());
+        sim.run();
+        runs++;
+        crudeEvents += sim.statistics().eventsProcessed;
+        if (sim.statistics().ventilatorShortages > 0) shortages++;
+    }
+    double crude = (double)shortages / runs;
+    cout << "Plain Monte Carlo, same events: " << shortages << " of " << runs << " runs had a shortage, estimate "
+         << crude;
+    if (shortages > 0) cout << " (relative error ~" << sqrt((1 - crude) / (runs * crude)) << ")";
+    cout << endl;
+    if (estimate > 0 && estimate < 1 && relativeError > 0) {
+        // Runs plain Monte Carlo would need for the splitting estimate's relative error
+        double needed = (1 - estimate) / (estimate * relativeError * relativeError);
+        cout << "Plain Monte Carlo would need ~" << needed << " runs (~" << needed * crudeEvents / runs
+             << " events) for the same relative error" << endl;
+    }
+
+    // Two-sided z-test of the difference; only meaningful when plain Monte
+    // Carlo saw shortages, that is when the event is not rare
+    if (shortages == 0 || shortages == runs) return true;
+    double standardError = sqrt(pow(estimate * relativeError, 2) + crude * (1 - crude) / runs);
+    double z = (estimate - crude) / standardError;
+    double p = erfc(fabs(z) / sqrt(2.0));
+    bool agree = p >= config.validationAlpha;
+    cout << (agree ? "Splitting and plain Monte Carlo agree" : "Splitting and plain Monte Carlo disagree")
+         << " (z " << z << ", p " << p << ", alpha " << config.validationAlpha << ")" << endl;
+    return agree;
+}
+
+// Sobol low-discrepancy sequence (Joe and Kuo direction numbers) with a
+// random digital shift. Any 2^m consecutive points from the start put exactly
+// one point in each of the 2^m equal slices of every axis, and fill the
+// joint space far more evenly than independent random points.
+class SobolSequence {
+public:
+    static const int MAX_DIMENSIONS = 16;
+
+    SobolSequence(int dimensions, unsigned int seed) : dimensions(dimensions), state(dimensions, 0), shift(dimensions) {
+        // Degree s, coefficients a and initial numbers m of the primitive
+        // polynomial of dimensions 2..16; dimension 1 is van der Corput
+        static const int degree[MAX_DIMENSIONS] = {0, 1, 2, 3, 3, 4, 4, 5, 5, 5, 5, 5, 5, 6, 6, 6};
+        static const int coefficients[MAX_DIMENSIONS] = {0, 0, 1, 1, 2, 1, 4, 2, 4, 7, 11, 13, 14, 1, 13, 16};
+        static const int initial[MAX_DIMENSIONS][6] = {
+            {}, {1}, {1, 3}, {1, 3, 1}, {1, 1, 1}, {1, 1, 3, 3}, {1, 3, 5, 13}, {1, 1, 5, 5, 17},
+            {1, 1, 5, 5, 5}, {1, 1, 7, 11, 19}, {1, 1, 5, 1, 1}, {1, 1, 1, 3, 11}, {1, 3, 5, 5, 31},
+            {1, 3, 3, 9, 7, 49}, {1, 1, 1, 15, 21, 21}, {1, 3, 1, 13, 27, 49}};
+        direction.assign(dimensions, vector<uint32_t>(BITS));
+        for (int d = 0; d < dimensions; ++d) {
+            vector<uint32_t>& v = direction[d];
+            if (d == 0) {
+                for (int i = 0; i < BITS; ++i) v[i] = 1u << (BITS - 1 - i);
+                continue;
+            }
+            int s = degree[d];
+            for (int i = 0; i < s; ++i) v[i] = (uint32_t)initial[d][i] << (BITS - 1 - i);
+            for (int i = s; i < BITS; ++i) {
+                v[i] = v[i - s] ^ (v[i - s] >> s);
+                for (int k = 1; k < s; ++k) {
+                    if ((coefficients[d] >> (s - 1 - k)) & 1) v[i] ^= v[i - k];
+                }
+            }
+        }
+        mt19937 rng(seed);
+        for (uint32_t& x : shift) x = rng();
+    }
+
+    // Next point of the unit cube (Gray-code order)
+    vector<double> next() {
+        vector<double> point(dimensions);
+        for (int d = 0; d < dimensions; ++d) point[d] = ((state[d] ^ shift[d]) + 0.5) / 4294967296.0;
+        int bit = 0;
+        for (uint64_t i = index; i & 1; i >>= 1) bit++;
+        if (bit < BITS) {
+            for (int d = 0; d < dimensions; ++d) state[d] ^= direction[d][bit];
+        }
+        index++;
+        return point;
+    }
+
+private:
+    static const int BITS = 32;
+    int dimensions;
+    uint64_t index = 0;
+    vector<uint32_t> state;
+    vector<uint32_t> shift;
+    vector<vector<uint32_t>> direction;
+};
+
+// Latin hypercube design: each axis is cut into one slice per point, and every
+// slice holds exactly one point, at a random position inside it. The slices
+// of different axes are paired by independent random permutations.
+vector<vector<double>> latinHypercube(int points, int dimensions, unsigned int seed) {
+    mt19937 rng(seed);
+    uniform_real_distribution<double> uniform(0, 1);
+    vector<vector<double>> design(points, vector<double>(dimensions));
+    vector<int> slices(points);
+    for (int d = 0; d < dimensions; ++d) {
+        iota(slices.begin(), slices.end(), 0);
+        shuffle(slices.begin(), slices.end(), rng);
+        for (int i = 0; i < points; ++i) design[i][d] = (slices[i] + uniform(rng)) / points;
+    }
+    return design;
+}
+
+// One input of a sweep: a configuration key and its range. Integer ranges
+// (both bounds without a decimal point) give whole values, each equally likely.
+struct SweepFactor {
+    string key;
+    double low = 0, high = 0;
+    bool integer = false;
+
+    string valueAt(double u) const {
+        ostringstream out;
+        if (integer) out << min((long long)high, (long long)low + (long long)floor(u * (high - low + 1)));
+        else out << setprecision(10) << low + u * (high - low);
+        return out.str();
+    }
+};
+
+// Parses sweepFactors, "key=low:high,key=low:high,...", checking every key
+// against applyOption
+bool parseSweepFactors(const string& spec, vector<SweepFactor>& factors, string& error) {
+    stringstream list(spec);
+    string item;
+    while (getline(list, item, ',')) {
+        size_t equals = item.find('='), colon = item.find(':');
+        if (equals == string::npos || colon == string::npos || colon < equals) {
+            error = "expected key=low:high, got \"" + item + "\"";
+            return false;
+        }
+        SweepFactor factor;
+        factor.key = item.substr(0, equals);
+        string low = item.substr(equals + 1, colon - equals - 1), high = item.substr(colon + 1);
+        try {
+            factor.low = stod(low);
+            factor.high = stod(high);
+        } catch (const exception&) {
+            error = "bad range in \"" + item + "\"";
+            return false;
+        }
+        factor.integer = low.find('.') == string::npos && high.find('.') == string::npos;
+        SimConfig probe;
+        if (factor.high < factor.low || !applyOption(probe, factor.key, low)) {
+            error = factor.high < factor.low ? "empty range in \"" + item + "\"" : "unknown option " + factor.key;
+            return false;
+        }
+        factors.push_back(factor);
+    }
+    if (factors.empty()) error = "sweepFactors is empty";
+    return !factors.empty();
+}
+
+// Function to run a space-filling experiment design over sweepFactors and
+// write one CSV row per design point, for fitting a metamodel. Each point
+// runs sweepReplications replications on workerThreads threads. Replication r
+// uses seed + r at every point (common random numbers), so differences
+// between points come from the inputs rather than from the random draws.
+// Returns false, before running anything, if the factors can give a
+// configuration that checkConfig rejects.
+bool runSweep() {
+    unsigned int seed = config.seed != 0 ? config.seed : (unsigned int)time(0);
+    int points = max(config.sweepPoints, 1);
+    int replications = max(config.sweepReplications, 1);
+    vector<SweepFactor> factors;
+    string error;
+    if (!parseSweepFactors(config.sweepFactors, factors, error)) {
+        cerr << "Bad sweepFactors: " << error << endl;
+        return false;
+    }
+    int dimensions = (int)factors.size();
+    if (config.horizonSeconds == SimConfig().horizonSeconds) {
+        cerr << "Warning: the horizon is the " << config.horizonSeconds << " s default; set horizonSeconds or "
+             << "horizonDays to the run length the metamodel is for" << endl;
+    }
+
+    // The checked constraints are bounds on single values or on pairs such as
+    // arrivalMinSeconds <= arrivalMaxSeconds, so a factor box whose corners
+    // all pass has no invalid point inside (checked up to 16 factors, 65536
+    // corners; every point is checked below in any case)
+    if (dimensions <= 16) {
+        for (long long corner = 0; corner < (1LL << dimensions); ++corner) {
+            SimConfig c = config;
+            string where;
+            for (int d = 0; d < dimensions; ++d) {
+                string value = factors[d].valueAt((corner >> d) & 1 ? 1.0 : 0.0);
+                applyOption(c, factors[d].key, value);
+                where += (d > 0 ? ", " : "") + factors[d].key + "=" + value;
+            }
+            if (!checkConfig(c, error)) {
+                cerr << "Bad sweepFactors: the ranges include an invalid configuration (" << where << "): " << error
+                     << endl;
+                return false;
+            }
+        }
+    }
+
+    vector<vector<double>> design;
+    if (config.sweepDesign == "sobol") {
+        if (dimensions > SobolSequence::MAX_DIMENSIONS) {
+            cerr << "The Sobol design supports up to " << SobolSequence::MAX_DIMENSIONS << " factors; use lhs" << endl;
+            return false;
+        }
+        SobolSequence sobol(dimensions, seed);
+        for (int i = 0; i < points; ++i) design.push_back(sobol.next());
+        if (points & (points - 1)) cout << "Note: Sobol points are evenest when sweepPoints is a power of two" << endl;
+    } else if (config.sweepDesign == "lhs") {
+        design = latinHypercube(points, dimensions, seed);
+    } else {
+        cerr << "Unknown sweepDesign " << config.sweepDesign << " (expected sobol or lhs)" << endl;
+        return false;
+    }
+
+    // Configurations of the design points, checked before anything runs
+    vector<SimConfig> configs(points, config);
+    vector<vector<string>> values(points, vector<string>(dimensions));
+    for (int i = 0; i < points; ++i) {
+        for (int d = 0; d < dimensions; ++d) {
+            values[i][d] = factors[d].valueAt(design[i][d]);
+            applyOption(configs[i], factors[d].key, values[i][d]);
+        }
+        if (!checkConfig(configs[i], error)) {
+            cerr << "Design point " << i << " is invalid: " << error << endl;
+            return false;
+        }
+    }
+
+    ofstream out(config.sweepOutput);
+    if (!out) {
+        cerr << "Cannot write " << config.sweepOutput << endl;
+        return false;
+    }
+    CpuTopology topology = CpuTopology::detect();
+    int workers = min(replicationWorkers(topology), points);
+    cout << "Sweep: " << points << " " << config.sweepDesign << " points over " << dimensions << " factors, "
+         << replications << " replication(s) each (seed " << seed << ") on " << workers << " worker(s)..." << endl;
+
+    // Means over the replications of a point; failed points keep their error
+    struct PointResult {
+        SimulationResults mean;
+        double meanArrived = 0, meanTreated = 0, meanAbandoned = 0;
+        string error;
+    };
+    vector<PointResult> results(points);
+    atomic<int> next(0);
+    atomic<long long> events(0);
+    vector<thread> threads;
+    auto start = chrono::steady_clock::now();
+    for (int w = 0; w < workers; ++w) {
+        threads.emplace_back([&] {
+            unique_ptr<Simulation> sim;
+            for (int i = next++; i < points; i = next++) {
+                PointResult& result = results[i];
+                bool ok = sim ? sim->reconfigure(configs[i], result.error)
+                              : (bool)(sim = Simulation::create(configs[i], result.error));
+                if (!ok) continue;
+                SimulationResults& mean = result.mean;
+                for (int r = 0; r < replications; ++r) {
+                    sim->reset(seed + r);
+                    const SimulationResults& run = sim->run();
+                    for (int p = 0; p < PRIORITY_LEVELS; ++p) {
+                        mean.meanWaitSeconds[p] += run.meanWaitSeconds[p] / replications;
+                        result.meanArrived += (double)run.arrived[p] / replications;
+                        result.meanTreated += (double)run.treated[p] / replications;
+                        result.meanAbandoned += (double)run.abandoned[p] / replications;
+                    }
+                    mean.meanQueueLength += run.meanQueueLength / replications;
+                    mean.meanWardOccupancy += run.meanWardOccupancy / replications;
+                    mean.ventilatorShortages += run.ventilatorShortages;
+                    events += run.eventsProcessed;
+                }
+            }
+        });
+    }
+    for (thread& t : threads) t.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    out << "point";
+    for (const SweepFactor& factor : factors) out << ',' << factor.key;
+    out << ",meanWaitHigh,meanWaitMedium,meanWaitLow,arrived,treated,abandoned,ventilatorShortages,"
+           "meanQueueLength,meanWardOccupancy,error\n";
+    int failed = 0;
+    for (int i = 0; i < points; ++i) {
+        const PointResult& result = results[i];
+        out << i;
+        for (const string& value : values[i]) out << ',' << value;
+        if (!result.error.empty()) {
+            out << ",,,,,,,,,,\"" << result.error << "\"\n";
+            failed++;
+            continue;
+        }
+        const SimulationResults& mean = result.mean;
+        out << ',' << mean.meanWaitSeconds[HIGH] << ',' << mean.meanWaitSeconds[MEDIUM] << ','
+            << mean.meanWaitSeconds[LOW] << ',' << result.meanArrived << ',' << result.meanTreated << ','
+            << result.meanAbandoned << ',' << (double)mean.ventilatorShortages / replications << ','
+            << mean.meanQueueLength << ',' << mean.meanWardOccupancy << ",\n";
+    }
+    cout << fixed << setprecision(2) << "Ran " << (long long)points * replications << " replications in " << seconds
+         << " s (" << events / max(seconds, 1e-9) / 1e6 << " M events/s)" << defaultfloat << endl;
+    if (failed > 0) cout << failed << " point(s) had an invalid configuration (see the error column)" << endl;
+    cout << "Results written to " << config.sweepOutput << endl;
+    return failed == 0;
+}
+
+// Shared-memory region of the replication farm, mapped before the fork. Each
+// replication has one slot: a worker process claims the next replication with
+// a fetch-and-add on `next`, writes the summary into its slot and then marks
+// it ready with a release store, so the parent never sees a half-written one.
+// The atomics are lock-free and address-free, so they work across processes.
+struct FarmRegion {
+    enum SlotState { SLOT_EMPTY, SLOT_CLAIMED, SLOT_READY };
+
+    struct Slot {
+        atomic<int> state;
+        int pid;
+        ReplicationSummary summary;
+    };
+
+    atomic<int> next;
+    int replications;
+    Slot slots[1];  // `replications` slots follow
+
+    static size_t bytesFor(int replications) {
+        return sizeof(FarmRegion) + sizeof(Slot) * (replications - 1);
+    }
+};
+
+// Worker process body: runs replications until none are left; false if the
+// engine could not be built
+bool farmWorker(FarmRegion* region, unsigned int seed) {
+    int pid = (int)getpid();
+    unique_ptr<Simulation> sim = makeReplicationEngine();
+    if (!sim) return false;
+    for (int r = region->next.fetch_add(1); r < region->replications; r = region->next.fetch_add(1)) {
+        FarmRegion::Slot& slot = region->slots[r];
+        slot.state.store(FarmRegion::SLOT_CLAIMED, memory_order_relaxed);
+        slot.pid = pid;
+        slot.summary = runReplication(*sim, seed + r);
+        slot.state.store(FarmRegion::SLOT_READY, memory_order_release);
+    }
+    return true;
+}
+
+// Function to run replications in forked worker processes. The parent only
+// reads the shared region: it prints running results while the workers run,
+// then reports the replications lost to a worker that died. False if a worker
+// failed or replications were lost.
+bool runReplicationFarm() {
+    static_assert(ATOMIC_INT_LOCK_FREE == 2, "the farm needs lock-free atomics in shared memory");
+    unsigned int seed = config.seed != 0 ? config.seed : (unsigned int)time(0);
+    int replications = max(config.replications, 1);
+    int processes = config.farmProcesses > 0 ? config.farmProcesses : max(1, (int)thread::hardware_concurrency());
+
+    size_t bytes = FarmRegion::bytesFor(replications);
+    void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        cerr << "Cannot map the farm's shared region: " << strerror(errno) << endl;
+        return false;
+    }
+    FarmRegion* region = (FarmRegion*)memory;
+    new (&region->next) atomic<int>(0);
+    region->replications = replications;
+    for (int r = 0; r < replications; ++r) new (&region->slots[r].state) atomic<int>(FarmRegion::SLOT_EMPTY);
+
+    cout << "Replication farm: " << replications << " replications (seed " << seed << ") in " << processes
+         << " worker process(es)..." << endl;
+    cout.flush(); // Nothing buffered may be duplicated into the children
+
+    auto start = chrono::steady_clock::now();
+    vector<pid_t> workers;
+    for (int w = 0; w < processes; ++w) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            _exit(farmWorker(region, seed) ? 0 : 1);
+        }
+        if (pid < 0) {
+            cerr << "fork failed after " << workers.size() << " worker(s): " << strerror(errno) << endl;
+            break;
+        }
+        workers.push_back(pid);
+    }
+
+    // Live aggregation: fold in slots as they become ready
+    vector<char> seen(replications, 0);
+    vector<ReplicationSummary> results;
+    double waitSum = 0;
+    int running = (int)workers.size();
+    int failed = 0;
+    auto lastReport = start;
+    while (running > 0) {
+        int status;
+        pid_t done;
+        while ((done = waitpid(-1, &status, WNOHANG)) > 0) {
+            running--;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed++;
+        }
+        for (int r = 0; r < replications; ++r) {
+            if (seen[r] || region->slots[r].state.load(memory_order_acquire) != FarmRegion::SLOT_READY) continue;
+            seen[r] = 1;
+            results.push_back(region->slots[r].summary);
+            const ReplicationSummary& s = results.back();
+            waitSum += (s.meanWait[HIGH] + s.meanWait[MEDIUM] + s.meanWait[LOW]) / PRIORITY_LEVELS;
+        }
+        auto now = chrono::steady_clock::now();
+        if (running > 0 && now - lastReport >= chrono::seconds(1) && !results.empty()) {
+            lastReport = now;
+            cout << fixed << setprecision(2) << "  " << results.size() << "/" << replications
+                 << " done, mean wait so far " << waitSum / results.size() << " s" << defaultfloat << endl;
+        }
+        if (running > 0) this_thread::sleep_for(chrono::milliseconds(20));
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    int lost = replications - (int)results.size();
+    long long events = 0;
+    for (const ReplicationSummary& r : results) events += r.events;
+    cout << fixed << setprecision(2) << "Ran in " << seconds << " s (" << results.size() / max(seconds, 1e-9)
+         << " replications/s, " << events / max(seconds, 1e-9) / 1e6 << " M events/s)" << defaultfloat << endl;
+    if (failed > 0 || lost > 0) {
+        cout << failed << " worker process(es) failed; " << lost << " replication(s) lost" << endl;
+    }
+    if (!results.empty()) printReplicationSummaries(results);
+    munmap(memory, bytes);
+    return failed == 0 && lost == 0;
+}
 
-// Struct for Patient
-struct Patient {
-    int id;
-    string name;
-    Priority priority;
-    Patient(int id, string name, Priority priority) : id(id), name(name), priority(priority) {}
+// Lockstep replications of the core model for staffing screens: Poisson
+// arrivals with the configured mean spacing, exponential treatment, equal
+// shares of the three priorities, and as many servers as there are complete
+// doctor/nurse/room/thread teams. The chain is uniformized at the constant rate
+// lambda + servers * mu, so every replication takes the same number of steps
+// and the lanes never diverge: each step draws one event per lane and applies
+// it with masks instead of branches. Time averages use the expected step
+// length 1/rate, which needs no logarithm and keeps the loops vectorizable.
+struct LockstepModel {
+    uint32_t servers;
+    uint32_t arrivalThreshold;         // u < arrivalThreshold: arrival
+    uint32_t serviceStep;              // per busy server: departure
+    long long steps;
+    double stepSeconds;
 };
 
-// Compare function for priority queue
-struct ComparePatient {
-    bool operator()(shared_ptr<Patient> a, shared_ptr<Patient> b) {
-        if (a->priority == b->priority) {
-            return a->id > b->id; // First-Come, First-Served for same priority
-        }
-        return a->priority > b->priority; // Higher priority comes first
-    }
+struct LockstepResult {
+    double waitSeconds[PRIORITY_LEVELS];  // mean queue wait (Little's law)
+    double utilization;
 };
 
-// Semaphore Implementation
-class Semaphore {
-private:
-    int count;
-    mutex mtx;
-    condition_variable cv;
+LockstepModel makeLockstepModel(const SimConfig& cfg) {
+    LockstepModel model;
+    model.servers = (uint32_t)max(0, min(min(cfg.doctors, cfg.nurses), min(cfg.examRooms, cfg.doctorThreads)));
+    double lambda = 2.0 / (cfg.arrivalMinSeconds + cfg.arrivalMaxSeconds);
+    double mu = 1.0 / cfg.treatmentSeconds;
+    double rate = lambda + model.servers * mu;
+    const double scale = 4294967295.0;
+    model.arrivalThreshold = (uint32_t)(lambda / rate * scale);
+    model.serviceStep = (uint32_t)(mu / rate * scale);
+    model.steps = (long long)llround(cfg.horizonSeconds * rate);
+    model.stepSeconds = 1.0 / rate;
+    return model;
+}
 
-public:
-    Semaphore(int initialCount) : count(initialCount) {}
+// Per-replication xorshift32 state, decorrelated with a splitmix64 seed
+uint32_t lockstepSeed(uint64_t seed, uint64_t replication) {
+    uint64_t z = seed + (replication + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return (uint32_t)z | 1u;
+}
 
-    void acquire() {
-        unique_lock<mutex> lock(mtx);
-        cv.wait(lock, [this] { return count > 0; });
-        --count;
+// Runs LANES replications side by side; all state is in lane-major arrays
+template <int LANES>
+void runLockstepBlock(const LockstepModel& model, uint64_t seed, uint64_t firstReplication,
+                      vector<LockstepResult>& results) {
+    uint32_t rng[LANES], busy[LANES], q0[LANES], q1[LANES], q2[LANES];
+    uint64_t area0[LANES], area1[LANES], area2[LANES], busyArea[LANES];
+    uint32_t arrived0[LANES], arrived1[LANES], arrived2[LANES];
+    for (int l = 0; l < LANES; ++l) {
+        rng[l] = lockstepSeed(seed, firstReplication + l);
+        busy[l] = q0[l] = q1[l] = q2[l] = 0;
+        area0[l] = area1[l] = area2[l] = busyArea[l] = 0;
+        arrived0[l] = arrived1[l] = arrived2[l] = 0;
     }
+    const uint32_t third = 0xFFFFFFFFu / 3;
+    const uint32_t servers = model.servers, arrivalThreshold = model.arrivalThreshold;
+    const uint32_t serviceStep = model.serviceStep;
 
-    void release() {
-        {
-            lock_guard<mutex> lock(mtx);
-            ++count;
+    for (long long step = 0; step < model.steps; ++step) {
+        for (int l = 0; l < LANES; ++l) {
+            uint32_t x = rng[l];
+            x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+            uint32_t u = x;
+            x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+            uint32_t v = x;
+            rng[l] = x;
+
+            uint32_t arrival = u < arrivalThreshold;
+            uint32_t departure = (1 - arrival) & ((u - arrivalThreshold) < busy[l] * serviceStep);
+            uint32_t high = v < third, medium = (1 - high) & (v < 2 * third), low = 1 - high - medium;
+
+            // Arrivals start treatment if a team is free, otherwise join their queue
+            uint32_t free = busy[l] < servers;
+            uint32_t queued = arrival & (1 - free);
+            busy[l] += arrival & free;
+            q0[l] += queued & high;
+            q1[l] += queued & medium;
+            q2[l] += queued & low;
+            arrived0[l] += arrival & high;
+            arrived1[l] += arrival & medium;
+            arrived2[l] += arrival & low;
+
+            // A departure hands its team to the highest-priority waiting patient
+            uint32_t take0 = departure & (q0[l] != 0);
+            uint32_t take1 = departure & (q0[l] == 0) & (q1[l] != 0);
+            uint32_t take2 = departure & (q0[l] == 0) & (q1[l] == 0) & (q2[l] != 0);
+            q0[l] -= take0;
+            q1[l] -= take1;
+            q2[l] -= take2;
+            busy[l] -= departure & (1 - (take0 | take1 | take2));
+
+            area0[l] += q0[l];
+            area1[l] += q1[l];
+            area2[l] += q2[l];
+            busyArea[l] += busy[l];
         }
-        cv.notify_one();
     }
 
-    bool try_acquire() {
-        lock_guard<mutex> lock(mtx);
-        if (count > 0) {
-            --count;
-            return true;
-        }
-        return false;
+    for (int l = 0; l < LANES; ++l) {
+        LockstepResult& r = results[firstReplication + l];
+        r.waitSeconds[HIGH] = arrived0[l] ? area0[l] * model.stepSeconds / arrived0[l] : 0;
+        r.waitSeconds[MEDIUM] = arrived1[l] ? area1[l] * model.stepSeconds / arrived1[l] : 0;
+        r.waitSeconds[LOW] = arrived2[l] ? area2[l] * model.stepSeconds / arrived2[l] : 0;
+        r.utilization = model.servers && model.steps ? (double)busyArea[l] / model.steps / model.servers : 0;
     }
+}
 
-    int available() {
-        lock_guard<mutex> lock(mtx);
-        return count;
+// Erlang C mean queue wait of an M/M/c queue, the reference for the overall wait
+double erlangCWaitSeconds(double lambda, double mu, int servers) {
+    double load = lambda / mu;
+    if (servers <= 0 || load >= servers) return numeric_limits<double>::infinity();
+    double term = 1, sum = 1;
+    for (int k = 1; k < servers; ++k) {
+        term *= load / k;
+        sum += term;
     }
-};
+    double last = term * load / servers / (1 - load / servers);
+    return last / (sum + last) / (servers * mu - lambda);
+}
 
-// Shared resources
-priority_queue<shared_ptr<Patient>, vector<shared_ptr<Patient>>, ComparePatient> patientQueue;
-mutex queueMutex;
-condition_variable cv;
+void runLockstep() {
+    unsigned int seed = config.seed != 0 ? config.seed : (unsigned int)time(0);
+    int lanes = config.lockstepLanes;
+    if (lanes != 1 && lanes != 8 && lanes != 16) {
+        cerr << "lockstepLanes must be 1, 8 or 16" << endl;
+        return;
+    }
+    if (config.admitProbability[HIGH] + config.admitProbability[MEDIUM] + config.admitProbability[LOW] > 0 ||
+        config.deteriorationMeanMinutes[MEDIUM] + config.deteriorationMeanMinutes[LOW] > 0 ||
+        config.abandonMeanMinutes[HIGH] + config.abandonMeanMinutes[MEDIUM] + config.abandonMeanMinutes[LOW] > 0 ||
+        config.ventilatorMtbfHours + config.roomMtbfHours > 0 || config.staffBreaks || config.dynamicResources) {
+        cout << "Note: lockstep mode models only arrivals, teams and treatment; wards, breaks, "
+                "resource changes, failures, deterioration and abandonment are ignored." << endl;
+    }
 
-// Semaphores for resource management
-Semaphore doctorsAvailable(3);
-Semaphore nursesAvailable(2);
-Semaphore examRoomsAvailable(2);
-Semaphore ventilatorsAvailable(1);
+    LockstepModel model = makeLockstepModel(config);
+    int blocks = (max(config.replications, 1) + lanes - 1) / lanes;
+    vector<LockstepResult> results((size_t)blocks * lanes);
+    cout << "Lockstep screen (seed " << seed << "): " << results.size() << " replications of "
+         << config.horizonSeconds / 3600 << " h, " << model.servers << " teams, " << lanes << " lanes..." << endl;
 
-atomic<bool> isRunning(true);
+    auto start = chrono::steady_clock::now();
+    for (int b = 0; b < blocks; ++b) {
+        if (lanes == 16) runLockstepBlock<16>(model, seed, (uint64_t)b * lanes, results);
+        else if (lanes == 8) runLockstepBlock<8>(model, seed, (uint64_t)b * lanes, results);
+        else runLockstepBlock<1>(model, seed, (uint64_t)b * lanes, results);
+    }
+    double cpuSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
 
-// Helper function to convert priority to string
-string priorityToString(Priority priority) {
-    switch (priority) {
-        case HIGH: return "High";
-        case MEDIUM: return "Medium";
-        case LOW: return "Low";
-        default: return "Unknown";
+    // Mean and 95% confidence half-width across replications
+    auto summarize = [&](function<double(const LockstepResult&)> metric, double& mean, double& halfWidth) {
+        double sum = 0, sumSquares = 0;
+        for (const LockstepResult& r : results) {
+            double x = metric(r);
+            sum += x;
+            sumSquares += x * x;
+        }
+        double n = (double)results.size();
+        mean = sum / n;
+        double variance = n > 1 ? max(0.0, (sumSquares - n * mean * mean) / (n - 1)) : 0;
+        halfWidth = 1.96 * sqrt(variance / n);
+    };
+
+    cout << fixed << setprecision(2);
+    cout << "Ran " << model.steps << " steps per replication in " << cpuSeconds << " s ("
+         << results.size() / max(cpuSeconds, 1e-9) << " replications/s)" << endl;
+    const char* names[PRIORITY_LEVELS] = {"High", "Medium", "Low"};
+    double mean, halfWidth;
+    for (int p = 0; p < PRIORITY_LEVELS; ++p) {
+        summarize([p](const LockstepResult& r) { return r.waitSeconds[p]; }, mean, halfWidth);
+        cout << setw(10) << names[p] << " mean wait " << setw(12) << mean << " s  +/- " << halfWidth << endl;
     }
+    summarize([](const LockstepResult& r) {
+        return (r.waitSeconds[HIGH] + r.waitSeconds[MEDIUM] + r.waitSeconds[LOW]) / PRIORITY_LEVELS;
+    }, mean, halfWidth);
+    double lambda = 2.0 / (config.arrivalMinSeconds + config.arrivalMaxSeconds);
+    cout << "   Overall mean wait " << setw(12) << mean << " s  +/- " << halfWidth << " (Erlang C "
+         << erlangCWaitSeconds(lambda, 1.0 / config.treatmentSeconds, (int)model.servers) << " s)" << endl;
+    summarize([](const LockstepResult& r) { return r.utilization; }, mean, halfWidth);
+    cout << "Team utilization " << mean << " +/- " << halfWidth << endl;
+    cout << defaultfloat;
 }
 
-// Function to display the current state of resources
-void displayState(const string& entity, int id, const string& name, const string& priority, const string& status) {
-    cout << setw(10) << entity << setw(10) << id
-         << setw(20) << name
-         << setw(15) << priority
-         << setw(20) << status
-         << setw(10) << doctorsAvailable.available()
-         << setw(10) << nursesAvailable.available()
-         << setw(10) << examRoomsAvailable.available()
-         << setw(10) << ventilatorsAvailable.available() << endl;
+// Hold-model benchmark step: the queue starts with `pending` events, then each
+// hold pops the earliest event and schedules one new event at that time plus
+// the next precomputed increment. Returns ns per hold and a checksum of the
+// popped sequence, which must agree across backends.
+template <typename Q>
+double benchmarkHold(Q& queue, const vector<SimTime>& increments, size_t pending, unsigned long long& checksum) {
+    typedef DiscreteEventSimulation::Event Event;
+    unsigned long long seq = 0;
+    for (size_t i = 0; i < pending; ++i) {
+        queue.push({increments[i], seq++, DiscreteEventSimulation::ARRIVAL, (int)i});
+    }
+
+    checksum = 0;
+    auto start = chrono::steady_clock::now();
+    for (size_t i = pending; i < increments.size(); ++i) {
+        Event e = queue.top();
+        queue.pop();
+        checksum = checksum * 31 + (unsigned long long)e.time + (unsigned long long)e.subject;
+        queue.push({e.time + increments[i], seq++, e.type, (int)i});
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return seconds * 1e9 / (increments.size() - pending);
 }
 
-// Function for treating a patient
-void treatPatient(int doctorId) {
-    while (isRunning) {
-        shared_ptr<Patient> currentPatient = nullptr;
-        {
-            unique_lock<mutex> lock(queueMutex);
-            cv.wait(lock, [] { return !patientQueue.empty() || !isRunning; });
+// Function to compare the future event lists on event mixes from the hospital model
+void runEventListBenchmark() {
+    typedef DiscreteEventSimulation::Event Event;
 
-            if (!isRunning && patientQueue.empty()) break;
+    // Share of arrivals, treatment ends, timers (deterioration, abandonment),
+    // ward discharges and return visits among the scheduled events
+    struct EventMix {
+        const char* name;
+        double weights[5];
+    };
+    const EventMix mixes[] = {
+        {"ed-only", {0.5, 0.5, 0.0, 0.0, 0.0}},
+        {"hospital", {0.3, 0.3, 0.25, 0.1, 0.05}},
+        {"far-skewed", {0.2, 0.2, 0.2, 0.2, 0.2}},
+    };
+    const size_t sizes[] = {1000, 100000, 1000000};
+    const size_t holds = config.benchHolds;
+    const char* backends[] = {"heap", "tiered", "pairing", "calendar", "radix"};
 
-            currentPatient = patientQueue.top();
-            patientQueue.pop();
-        }
+    unsigned int seed = config.seed != 0 ? config.seed : 12345;
+    cout << "Future event list hold benchmark (" << holds << " holds per run, seed " << seed << ")" << endl;
+    cout << setw(12) << "Mix" << setw(10) << "Pending" << setw(10) << "Queue" << setw(12) << "ns/hold" << endl;
 
-        doctorsAvailable.acquire(); // Acquire a doctor
-        nursesAvailable.acquire();  // Acquire a nurse
-        examRoomsAvailable.acquire(); // Acquire an exam room
+    for (const EventMix& mix : mixes) {
+        for (size_t pending : sizes) {
+            if (pending > config.benchMaxPending) continue;
+            mt19937 rng(seed);
+            discrete_distribution<int> pick(mix.weights, mix.weights + 5);
+            uniform_int_distribution<int> arrivalGap(1, 5);
+            exponential_distribution<double> treatment(1.0 / (15 * 60.0));
+            exponential_distribution<double> timer(1.0 / (2 * 3600.0));
+            exponential_distribution<double> wardStay(1.0 / (3.5 * 86400.0));
+            exponential_distribution<double> returnDelay(1.0 / (3 * 86400.0));
 
-        // Try to allocate ventilator if needed
-        bool ventilatorAllocated = false;
-        if (currentPatient->priority == HIGH) {
-            if (ventilatorsAvailable.try_acquire()) {
-                ventilatorAllocated = true;
-            } else {
-                cout << "Ventilator unavailable for " << currentPatient->name << endl;
+            vector<SimTime> increments(pending + holds);
+            for (SimTime& inc : increments) {
+                double seconds = 0;
+                switch (pick(rng)) {
+                    case 0: seconds = arrivalGap(rng); break;
+                    case 1: seconds = treatment(rng); break;
+                    case 2: seconds = timer(rng); break;
+                    case 3: seconds = wardStay(rng); break;
+                    case 4: seconds = returnDelay(rng); break;
+                }
+                inc = secondsToTicks(seconds) + 1;
+            }
+
+            unsigned long long reference = 0;
+            for (const char* backend : backends) {
+                unsigned long long checksum = 0;
+                double ns = 0;
+                string name = backend;
+                string detail;
+                if (name == "heap") {
+                    BinaryHeapQueue<Event> q;
+                    ns = benchmarkHold(q, increments, pending, checksum);
+                } else if (name == "tiered") {
+                    TieredHeapQueue<Event> q;
+                    ns = benchmarkHold(q, increments, pending, checksum);
+                } else if (name == "pairing") {
+                    PairingHeapQueue<Event> q;
+                    ns = benchmarkHold(q, increments, pending, checksum);
+                } else if (name == "radix") {
+                    RadixHeapQueue<Event> q;
+                    ns = benchmarkHold(q, increments, pending, checksum);
+                } else {
+                    CalendarQueue<Event> q;
+                    ns = benchmarkHold(q, increments, pending, checksum);
+                    detail = "  " + to_string(q.bucketCount()) + " buckets of " + to_string(q.bucketWidth()) +
+                             " ms, " + to_string(q.resizeCount()) + " resizes";
+                }
+                if (name == "heap") reference = checksum;
+                cout << setw(12) << mix.name << setw(10) << pending << setw(10) << backend
+                     << setw(12) << fixed << setprecision(1) << ns << defaultfloat
+                     << detail << (checksum != reference ? "  ORDER MISMATCH" : "") << endl;
             }
         }
+    }
+}
 
-        // Display treatment activity
-        displayState("Doctor", doctorId, currentPatient->name, priorityToString(currentPatient->priority), "Treating...");
+// Worker-scaling benchmark (--mode=bench-workers). N logical clinicians serve
+// an evenly paced stream of patients at benchLoad utilization; a treatment is
+// a wall-clock wait of benchTreatmentMs. Throughput counts the treatments
+// finished inside the run, so the first treatment time is lost to ramp-up.
+// Two executors:
+//   threads - one OS thread per clinician, as runRealTime does for doctors:
+//             each thread blocks on the queue and sleeps through a treatment;
+//   pool    - a fixed pool of workers; clinicians are a free count and a
+//             treatment is a completion deadline, so nothing blocks per clinician.
+// Dispatch latency is the time from enqueue to treatment start.
+struct WorkerBenchResult {
+    int threads = 0;
+    long long treated = 0;
+    vector<double> latencyMs;
+    long long contextSwitches = 0;
+    double rssMb = 0;        // resident memory growth with all workers running
+    string error;
+};
 
-        this_thread::sleep_for(chrono::seconds(2)); // Simulating treatment time
+// Resident set size of the process in MB, 0 where /proc is not available
+double residentMb() {
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line)) {
+        if (line.compare(0, 6, "VmRSS:") == 0) return stod(line.substr(6)) / 1024;
+    }
+    return 0;
+}
 
-        // Release resources
-        if (ventilatorAllocated) {
-            ventilatorsAvailable.release();
-        }
-        doctorsAvailable.release();  // Release the doctor
-        nursesAvailable.release();   // Release the nurse
-        examRoomsAvailable.release(); // Release the exam room
+long long contextSwitchCount() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
 
-        // Display completion activity
-        displayState("Doctor", doctorId, currentPatient->name, priorityToString(currentPatient->priority), "Finished");
+// Paces arrivals at `rate` per second for `seconds`, in 1 ms batches against
+// absolute deadlines; push(t) enqueues one patient stamped t
+void paceArrivals(double rate, double seconds, const function<void(chrono::steady_clock::time_point)>& push) {
+    auto start = chrono::steady_clock::now();
+    auto next = start;
+    long long produced = 0;
+    while (true) {
+        next += chrono::milliseconds(1);
+        this_thread::sleep_until(next);
+        auto now = chrono::steady_clock::now();
+        double elapsed = chrono::duration<double>(now - start).count();
+        if (elapsed >= seconds) break;
+        long long due = (long long)(rate * elapsed);
+        for (; produced < due; ++produced) push(now);
     }
 }
 
-// Function for adding patients to the queue
-void addPatient(int id, string name, Priority priority) {
+WorkerBenchResult benchThreadPerClinician(int clinicians, double rate) {
+    WorkerBenchResult result;
+    mutex mtx;
+    condition_variable queueCv;
+    deque<chrono::steady_clock::time_point> queue;
+    bool stopping = false;
+    chrono::steady_clock::time_point end = chrono::steady_clock::time_point::max();
+    auto treatment = chrono::duration<double, milli>(config.benchTreatmentMs);
+    vector<vector<double>> latencies(clinicians);
+    vector<long long> treated(clinicians, 0);
+
+    double rssBefore = residentMb();
+    long long switchesBefore = contextSwitchCount();
+    vector<thread> workers;
+    try {
+        for (int i = 0; i < clinicians; ++i) {
+            workers.emplace_back([&, i] {
+                while (true) {
+                    chrono::steady_clock::time_point enqueued;
+                    {
+                        unique_lock<mutex> lock(mtx);
+                        queueCv.wait(lock, [&] { return !queue.empty() || stopping; });
+                        if (stopping) break;
+                        enqueued = queue.front();
+                        queue.pop_front();
+                    }
+                    auto start = chrono::steady_clock::now();
+                    latencies[i].push_back(chrono::duration<double, milli>(start - enqueued).count());
+                    this_thread::sleep_for(treatment);
+                    if (chrono::steady_clock::now() <= end) treated[i]++;
+                }
+            });
+        }
+    } catch (const system_error& e) {
+        result.error = "stopped at " + to_string(workers.size()) + " threads: " + e.what();
+    }
+    result.threads = (int)workers.size();
+    result.rssMb = residentMb() - rssBefore;
+
+    if (result.error.empty()) {
+        end = chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(
+                                                  chrono::duration<double>(config.benchWorkerSeconds));
+        paceArrivals(rate, config.benchWorkerSeconds, [&](chrono::steady_clock::time_point t) {
+            {
+                lock_guard<mutex> lock(mtx);
+                queue.push_back(t);
+            }
+            queueCv.notify_one();
+        });
+    }
     {
-        lock_guard<mutex> lock(queueMutex);
-        auto newPatient = make_shared<Patient>(id, name, priority);
-        patientQueue.push(newPatient);
+        lock_guard<mutex> lock(mtx);
+        stopping = true;
+    }
+    queueCv.notify_all();
+    for (thread& t : workers) t.join();
+    result.contextSwitches = contextSwitchCount() - switchesBefore;
+    for (int i = 0; i < clinicians; ++i) {
+        result.treated += treated[i];
+        result.latencyMs.insert(result.latencyMs.end(), latencies[i].begin(), latencies[i].end());
+    }
+    return result;
+}
 
-        // Display patient arrival
-        displayState("Patient", id, name, priorityToString(priority), "Arrived");
+WorkerBenchResult benchPooled(int clinicians, int poolThreads, double rate) {
+    WorkerBenchResult result;
+    mutex mtx;
+    condition_variable poolCv;
+    deque<chrono::steady_clock::time_point> queue;
+    priority_queue<chrono::steady_clock::time_point, vector<chrono::steady_clock::time_point>,
+                   greater<chrono::steady_clock::time_point>> completions;
+    int freeClinicians = clinicians;
+    bool stopping = false;
+    chrono::steady_clock::time_point end = chrono::steady_clock::time_point::max();
+    auto treatment = chrono::duration_cast<chrono::steady_clock::duration>(
+        chrono::duration<double, milli>(config.benchTreatmentMs));
+
+    double rssBefore = residentMb();
+    long long switchesBefore = contextSwitchCount();
+    vector<thread> workers;
+    for (int i = 0; i < poolThreads; ++i) {
+        workers.emplace_back([&] {
+            unique_lock<mutex> lock(mtx);
+            while (!stopping) {
+                auto now = chrono::steady_clock::now();
+                if (!completions.empty() && completions.top() <= now) {
+                    completions.pop();
+                    ++freeClinicians;
+                    if (now <= end) result.treated++;
+                } else if (!queue.empty() && freeClinicians > 0) {
+                    result.latencyMs.push_back(chrono::duration<double, milli>(now - queue.front()).count());
+                    queue.pop_front();
+                    --freeClinicians;
+                    completions.push(now + treatment);
+                } else if (completions.empty()) {
+                    poolCv.wait(lock);
+                } else {
+                    poolCv.wait_until(lock, completions.top());
+                }
+            }
+        });
     }
-    cv.notify_one();
+    result.threads = poolThreads;
+    result.rssMb = residentMb() - rssBefore;
+
+    end = chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(
+                                              chrono::duration<double>(config.benchWorkerSeconds));
+    paceArrivals(rate, config.benchWorkerSeconds, [&](chrono::steady_clock::time_point t) {
+        {
+            lock_guard<mutex> lock(mtx);
+            queue.push_back(t);
+        }
+        poolCv.notify_one();
+    });
+    // Let the treatments in progress finish, as the threads do
+    this_thread::sleep_for(chrono::duration<double, milli>(config.benchTreatmentMs));
+    {
+        lock_guard<mutex> lock(mtx);
+        stopping = true;
+    }
+    poolCv.notify_all();
+    for (thread& t : workers) t.join();
+    result.contextSwitches = contextSwitchCount() - switchesBefore;
+    return result;
 }
 
-// Function to simulate patient arrivals
-void patientArrival() {
-    int patientId = 1;
-    while (isRunning) {
-        this_thread::sleep_for(chrono::seconds(rand() % 5 + 1)); // Random patient arrival time
-        addPatient(patientId++, "Patient_" + to_string(patientId), Priority(rand() % 3));
+double percentile(vector<double>& values, double q) {
+    if (values.empty()) return 0;
+    size_t k = (size_t)(q * (values.size() - 1));
+    nth_element(values.begin(), values.begin() + k, values.end());
+    return values[k];
+}
+
+void runWorkerBenchmark() {
+    vector<int> sweep;
+    stringstream list(config.benchWorkers);
+    string item;
+    while (getline(list, item, ',')) {
+        if (!item.empty()) sweep.push_back(stoi(item));
+    }
+    int poolThreads = config.benchPoolThreads > 0 ? config.benchPoolThreads
+                                                  : max(1, (int)thread::hardware_concurrency());
+    pthread_attr_t attr;
+    size_t stackBytes = 0;
+    pthread_attr_init(&attr);
+    pthread_attr_getstacksize(&attr, &stackBytes);
+    pthread_attr_destroy(&attr);
+
+    cout << "Worker scaling benchmark: " << config.benchWorkerSeconds << " s per run, treatment "
+         << config.benchTreatmentMs << " ms, load " << config.benchLoad << ", pool of " << poolThreads
+         << " threads, " << stackBytes / (1024 * 1024) << " MB stack per thread" << endl;
+    cout << setw(11) << "Clinicians" << setw(9) << "Model" << setw(9) << "Threads" << setw(12) << "Treated/s"
+         << setw(12) << "Offered/s" << setw(10) << "p50 ms" << setw(10) << "p99 ms" << setw(11) << "p99.9 ms"
+         << setw(12) << "Switches" << setw(12) << "Stacks MB" << setw(9) << "RSS MB" << endl;
+    cout << fixed;
+    for (int clinicians : sweep) {
+        double rate = config.benchLoad * clinicians / (config.benchTreatmentMs / 1000);
+        for (int model = 0; model < 2; ++model) {
+            WorkerBenchResult r = model == 0 ? benchThreadPerClinician(clinicians, rate)
+                                             : benchPooled(clinicians, poolThreads, rate);
+            cout << setw(11) << clinicians << setw(9) << (model == 0 ? "threads" : "pool") << setw(9) << r.threads
+                 << setprecision(0) << setw(12) << r.treated / config.benchWorkerSeconds << setw(12) << rate
+                 << setprecision(3) << setw(10) << percentile(r.latencyMs, 0.5)
+                 << setw(10) << percentile(r.latencyMs, 0.99) << setw(11) << percentile(r.latencyMs, 0.999)
+                 << setw(12) << r.contextSwitches << setprecision(0)
+                 << setw(12) << (double)r.threads * stackBytes / (1024 * 1024) << setprecision(1)
+                 << setw(9) << r.rssMb << endl;
+            if (!r.error.empty()) cout << "  " << r.error << endl;
+        }
     }
+    cout << defaultfloat;
 }
 
-// Function to simulate dynamic resource generation (shift changes or emergencies)
-void dynamicResourceGeneration() {
-    while (isRunning) {
-        this_thread::sleep_for(chrono::seconds(10)); // Simulate resource generation every 10 seconds
-        {
-            lock_guard<mutex> lock(queueMutex);
-            int newDoctors = rand() % 2; // Randomly add 0 or 1 doctor
-            int newNurses = rand() % 2;  // Randomly add 0 or 1 nurse
-            int newExamRooms = rand() % 2; // Randomly add 0 or 1 exam room
-            for (int i = 0; i < newDoctors; ++i) doctorsAvailable.release();
-            for (int i = 0; i < newNurses; ++i) nursesAvailable.release();
-            for (int i = 0; i < newExamRooms; ++i) examRoomsAvailable.release();
+// Hardware event counter of the calling thread; reads -1 where the kernel or
+// a sandbox does not allow perf_event_open
+class PerfCounter {
+private:
+    int fd = -1;
 
-            if (newDoctors > 0 || newNurses > 0 || newExamRooms > 0) {
-                cout << "Additional Resources: " << newDoctors << " doctor(s), " 
-                     << newNurses << " nurse(s), and " << newExamRooms 
-                     << " exam room(s) added due to shift changes or emergencies." << endl;
-            }
+public:
+    PerfCounter(uint32_t type, uint64_t event) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = event;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    ~PerfCounter() {
+        if (fd >= 0) close(fd);
+    }
+    PerfCounter(const PerfCounter&) = delete;
+    PerfCounter& operator=(const PerfCounter&) = delete;
+
+    void start() {
+        if (fd < 0) return;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    long long stop() {
+        if (fd < 0) return -1;
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        long long value = 0;
+        if (read(fd, &value, sizeof(value)) != sizeof(value)) return -1;
+        return value;
+    }
+};
+
+// Function to run the configured discrete-event scenario once per huge-page
+// mode and compare run time and dTLB misses
+void runHugePageBenchmark() {
+    unsigned int seed = config.seed != 0 ? config.seed : 12345;
+    const uint64_t dtlbLoadMisses = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    const uint64_t dtlbStoreMisses = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_WRITE << 8) |
+                                     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    cout << "Huge page benchmark: " << config.horizonSeconds / 3600 << " h horizon, " << config.eventList
+         << " event list, seed " << seed << endl;
+    cout << setw(12) << "Pages" << setw(10) << "Seconds" << setw(12) << "M events/s" << setw(12) << "Patients"
+         << setw(16) << "dTLB load miss" << setw(16) << "dTLB store miss" << setw(14) << "per 1k events"
+         << setw(11) << "Arena MB" << setw(10) << "Huge MB" << endl;
+
+    const char* names[3] = {"off", "transparent", "explicit"};
+    int previous = HugePageArena::mode;
+    for (int mode = HUGE_PAGES_OFF; mode <= HUGE_PAGES_EXPLICIT; ++mode) {
+        HugePageArena::mode = mode;
+        long long fallbacksBefore = HugePageArena::metrics.explicitFallbacks;
+        long long explicitBefore = HugePageArena::metrics.explicitBytes;
+        PerfCounter loads(PERF_TYPE_HW_CACHE, dtlbLoadMisses), stores(PERF_TYPE_HW_CACHE, dtlbStoreMisses);
+
+        DiscreteEventSimulation sim(config, seed);
+        auto start = chrono::steady_clock::now();
+        loads.start();
+        stores.start();
+        sim.run();
+        long long loadMisses = loads.stop(), storeMisses = stores.stop();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        const DiscreteEventSimulation::Stats& s = sim.statistics();
+        double hugeMb = mode == HUGE_PAGES_OFF ? 0 : anonHugePagesMb() +
+                        (HugePageArena::metrics.explicitBytes - explicitBefore) / 1048576.0;
+        cout << fixed << setw(12) << names[mode] << setprecision(2) << setw(10) << seconds
+             << setw(12) << s.eventsProcessed / max(seconds, 1e-9) / 1e6
+             << setw(12) << s.arrived[HIGH] + s.arrived[MEDIUM] + s.arrived[LOW];
+        if (loadMisses >= 0) {
+            cout << setw(16) << loadMisses << setw(16) << storeMisses << setw(14)
+                 << 1000.0 * (loadMisses + max(storeMisses, 0LL)) / max(s.eventsProcessed, 1LL);
+        } else {
+            cout << setw(16) << "n/a" << setw(16) << "n/a" << setw(14) << "n/a";
         }
+        cout << setprecision(1) << setw(11) << HugePageArena::metrics.liveBytes / 1048576.0 << setw(10) << hugeMb;
+        if (HugePageArena::metrics.explicitFallbacks > fallbacksBefore) cout << "  (no reserved pages; fell back)";
+        cout << defaultfloat << endl;
     }
+    HugePageArena::mode = previous;
 }
 
-// Function to simulate staff behavior, including fatigue and breaks
-void staffBehavior() {
-    while (isRunning) {
-        this_thread::sleep_for(chrono::seconds(20)); // Simulate break time for staff every 20 seconds
-        {
-            lock_guard<mutex> lock(queueMutex);
-            if (doctorsAvailable.try_acquire()) {
-                // Simulate a doctor taking a break and temporarily reducing availability
-                this_thread::sleep_for(chrono::seconds(5)); // Break duration
-                doctorsAvailable.release();
-                cout << "A doctor has returned from a break, increasing availability." << endl;
-            }
+// Hospital state rebuilt from an event log of the threaded mode
+struct HospitalState {
+    double time = 0;
+    int available[LOGGED_RESOURCES] = {};
+    int added[LOGGED_RESOURCES] = {};
+    map<int, Priority> waiting;        // patient id -> current priority
+    map<int, int> gettingResources;    // dequeued, doctor thread still acquiring
+    map<int, int> inTreatment;         // patient id -> doctor thread
+    int doctorsOnBreak = 0;
+    long long arrived = 0, treated = 0, left = 0;
+
+    void apply(const LogRecord& r) {
+        time = r.time;
+        switch (r.action) {
+            case LOG_START: available[r.subject] = r.value; break;
+            case LOG_ARRIVAL: waiting[r.subject] = Priority(r.value); arrived++; break;
+            case LOG_DEQUEUE: waiting.erase(r.subject); gettingResources[r.subject] = r.value; break;
+            case LOG_ACQUIRE: --available[r.subject]; break;
+            case LOG_RELEASE: ++available[r.subject]; break;
+            case LOG_TREATMENT_START: gettingResources.erase(r.subject); inTreatment[r.subject] = r.value; break;
+            case LOG_TREATMENT_END: inTreatment.erase(r.subject); treated++; break;
+            case LOG_BREAK_START: doctorsOnBreak++; break;
+            case LOG_BREAK_END: doctorsOnBreak--; break;
+            case LOG_RESOURCE_ADD: added[r.subject] += r.value; break;
+            case LOG_DETERIORATE: waiting[r.subject] = Priority(r.value); break;
+            case LOG_LEFT: waiting.erase(r.subject); left++; break;
+            case LOG_ACTIONS: break;
+        }
+    }
+};
+
+// Loads an event log and keeps a state snapshot every CHECKPOINT_RECORDS
+// records, so rebuilding any time point replays at most that many records
+class EventLogReplayer {
+private:
+    static const size_t CHECKPOINT_RECORDS = 4096;
+    vector<LogRecord> records;
+    vector<HospitalState> checkpoints; // state before record i * CHECKPOINT_RECORDS
+
+public:
+    bool load(const string& path) {
+        ifstream in(path);
+        if (!in) return false;
+        LogRecord r;
+        string action;
+        while (in >> r.time >> action >> r.subject >> r.value) {
+            int a = 0;
+            while (a < LOG_ACTIONS && action != LOG_ACTION_NAMES[a]) ++a;
+            if (a == LOG_ACTIONS) return false;
+            r.action = LogAction(a);
+            records.push_back(r);
+        }
+        if (!in.eof()) return false;
+
+        HospitalState state;
+        for (size_t i = 0; i < records.size(); ++i) {
+            if (i % CHECKPOINT_RECORDS == 0) checkpoints.push_back(state);
+            state.apply(records[i]);
         }
+        if (checkpoints.empty()) checkpoints.push_back(state);
+        return true;
+    }
+
+    // State after every record up to the given time; also reports how many
+    // records were replayed from the nearest checkpoint
+    HospitalState stateAt(double time, size_t& replayed) const {
+        size_t end = upper_bound(records.begin(), records.end(), time,
+                                 [](double t, const LogRecord& r) { return t < r.time; }) - records.begin();
+        size_t checkpoint = min(end / CHECKPOINT_RECORDS, checkpoints.size() - 1);
+        HospitalState state = checkpoints[checkpoint];
+        replayed = 0;
+        for (size_t i = checkpoint * CHECKPOINT_RECORDS; i < end; ++i, ++replayed) state.apply(records[i]);
+        return state;
+    }
+
+    size_t size() const { return records.size(); }
+    double duration() const { return records.empty() ? 0 : records.back().time; }
+};
+
+void runReplay() {
+    EventLogReplayer replayer;
+    auto start = chrono::steady_clock::now();
+    if (config.eventLogPath.empty() || !replayer.load(config.eventLogPath)) {
+        cerr << "Cannot read event log " << config.eventLogPath << " (set --eventLog=<file>)" << endl;
+        return;
+    }
+    double loadSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    double at = config.replayAtSeconds < 0 ? replayer.duration() : config.replayAtSeconds;
+    size_t replayed;
+    start = chrono::steady_clock::now();
+    HospitalState state = replayer.stateAt(at, replayed);
+    double rebuildSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << fixed << setprecision(3);
+    cout << "Event log " << config.eventLogPath << ": " << replayer.size() << " records over "
+         << replayer.duration() << " s, loaded in " << loadSeconds * 1000 << " ms" << endl;
+    cout << "State at " << at << " s rebuilt in " << rebuildSeconds * 1000 << " ms (" << replayed
+         << " records replayed from the nearest checkpoint)" << endl;
+    const char* names[LOGGED_RESOURCES] = {"Doctors", "Nurses", "Exam rooms", "Ventilators"};
+    for (int r = 0; r < LOGGED_RESOURCES; ++r) {
+        cout << setw(12) << names[r] << ": " << state.available[r] << " available";
+        if (state.added[r] > 0) cout << ", " << state.added[r] << " added so far";
+        cout << endl;
     }
+    cout << "Doctors on break: " << state.doctorsOnBreak << endl;
+    cout << "Arrived " << state.arrived << ", treated " << state.treated << ", left " << state.left << endl;
+    cout << "Waiting (" << state.waiting.size() << "):";
+    for (const auto& w : state.waiting) cout << " " << w.first << "/" << priorityToString(w.second);
+    cout << endl << "Acquiring resources (" << state.gettingResources.size() << "):";
+    for (const auto& g : state.gettingResources) cout << " " << g.first << "@doctor" << g.second;
+    cout << endl << "In treatment (" << state.inTreatment.size() << "):";
+    for (const auto& t : state.inTreatment) cout << " " << t.first << "@doctor" << t.second;
+    cout << endl << defaultfloat;
 }
 
-// Main function
-int main() {
-    srand(time(0));
+// Function to run the threaded model against the wall clock; false if it
+// could not start, every thread deadlocked in virtual time, or a replay
+// diverged from its recording
+bool runRealTime() {
+    unsigned int seed = config.seed != 0 ? config.seed : (unsigned int)time(0);
+    bool virtualClock = config.clock == "virtual";
+    bool replaying = !config.replaySchedulePath.empty();
+    bool recording = !replaying && !config.recordSchedulePath.empty();
+    if (virtualClock && (replaying || recording)) {
+        cerr << "A virtual clock run is already deterministic; drop recordSchedule/replaySchedule" << endl;
+        return false;
+    }
+    if (replaying) {
+        if (!scheduleLog.load(config.replaySchedulePath)) {
+            cerr << "Cannot read schedule " << config.replaySchedulePath << endl;
+            return false;
+        }
+        seed = scheduleLog.recordedSeed();
+        scheduleLog.startReplay();
+    } else if (recording) {
+        scheduleLog.startRecording(seed);
+    }
+    if (virtualClock) {
+        simClock.startVirtual();
+    } else if (replaying || recording) {
+        simClock.startSerialized(config.clockSpeed, config.lagToleranceMs, replaying);
+    } else {
+        simClock.startReal(config.clockSpeed, config.lagToleranceMs);
+    }
+    srand(seed);
+    // Record/replay compares the event stream even without a log file
+    if (!config.eventLogPath.empty() || replaying || recording) eventLog.open(!config.eventLogPath.empty());
+    isRunning = true;
+    nextPatientId = 1;
+    returnVisits = 0;
+    patientQueue = PatientQueue();
+    queuedPatients.clear();
+    boarders.clear();
+    boardingStats.reset();
+    for (int p = 0; p < PRIORITY_LEVELS; ++p) {
+        patientsArrived[p] = patientsDeteriorated[p] = patientsAbandoned[p] = 0;
+    }
+    runStats.reset(config.horizonSeconds);
+    shutdownStats.reset();
+    arrivalsStopped.reset();
+    treatmentsStopped.reset();
+    doctorsStopped.reset();
+    doctorsActive = config.doctorThreads;
+    if (config.doctorThreads == 0) doctorsStopped.raise();
+    doctorsAvailable.reset(config.doctors);
+    nursesAvailable.reset(config.nurses);
+    examRoomsAvailable.reset(config.examRooms);
+    ventilatorsAvailable.reset(config.ventilators);
+    ward.reset(config.wardBeds);
+    if (!config.liveViewPath.empty() && !liveView.open(config.liveViewPath, config.doctorThreads)) {
+        cerr << "Cannot map live view " << config.liveViewPath << endl;
+    }
+    if (!eventLines()) {
+        if (!liveView.frames()) liveView.openInMemory(config.doctorThreads);
+        dashboard.start(liveView.frames());
+    }
+    timers.start();
+    startEquipmentProcesses();
 
     cout << "Hospital Emergency Room Simulation Started..." << endl;
 
     // Display table headers
-    cout << setw(10) << "Entity" << setw(10) << "ID"
-         << setw(20) << "Name"
-         << setw(15) << "Priority"
-         << setw(20) << "Status"
-         << setw(10) << "Doctors"
-         << setw(10) << "Nurses"
-         << setw(10) << "Rooms"
-         << setw(10) << "Ventilators" << endl;
+    if (eventLines()) {
+        cout << setw(10) << "Entity" << setw(10) << "ID"
+             << setw(20) << "Name"
+             << setw(15) << "Priority"
+             << setw(20) << "Status"
+             << setw(10) << "Doctors"
+             << setw(10) << "Nurses"
+             << setw(10) << "Rooms"
+             << setw(10) << "Ventilators" << endl;
 
-    cout << string(120, '-') << endl;
+        cout << string(120, '-') << endl;
+    }
 
     // Create threads for doctors
     vector<thread> doctorThreads;
-    for (int i = 0; i < 3; ++i) {
+    for (int i = 0; i < config.doctorThreads; ++i) {
+        simClock.spawn(THREAD_DOCTOR_BASE + i + 1);
         doctorThreads.emplace_back(treatPatient, i + 1);
     }
 
     // Start patient arrival simulation
+    simClock.spawn(THREAD_ARRIVALS);
     thread patientThread(patientArrival);
 
     // Start dynamic resource generation
+    simClock.spawn(THREAD_RESOURCES);
     thread resourceThread(dynamicResourceGeneration);
 
     // Start staff behavior simulation (breaks, fatigue)
+    simClock.spawn(THREAD_STAFF);
     thread staffBehaviorThread(staffBehavior);
 
     // Let the simulation run for 30 seconds
-    this_thread::sleep_for(chrono::seconds(30));
-    isRunning = false;
+    simClock.sleepFor(config.horizonSeconds);
+    auto horizonWall = chrono::steady_clock::now();
+    auto horizonTime = simClock.now();
+    arrivalsStopped.raise(); // First: a staff break holds queueMutex while it sleeps
+    {
+        lock_guard<OrderedMutex> lock(queueMutex);
+        isRunning = false;
+    }
     cv.notify_all(); // Wake up all waiting threads
 
-    // Join threads
-    for (auto &t : doctorThreads) {
-        t.join();
+    // Drain: wait for the doctors to empty the queue, up to the deadline
+    if (config.shutdown == "drain") {
+        doctorsStopped.sleepUntil(horizonTime + simDuration(config.drainSeconds));
+    }
+    treatmentsStopped.raise();
+    doctorsAvailable.cancelWaits();
+    nursesAvailable.cancelWaits();
+    examRoomsAvailable.cancelWaits();
+    cv.notify_all();
+
+    // Join threads. After a virtual clock deadlock the threads still blocked
+    // are left behind, and the run stops with what it has.
+    bool deadlocked = false;
+    auto join = [&deadlocked](thread& t, int id) {
+        if (simClock.awaitExit(id)) {
+            t.join();
+            return;
+        }
+        deadlocked = true;
+        t.detach();
+    };
+    for (int i = 0; i < (int)doctorThreads.size(); ++i) join(doctorThreads[i], THREAD_DOCTOR_BASE + i + 1);
+    join(patientThread, THREAD_ARRIVALS);
+    join(resourceThread, THREAD_RESOURCES);
+    join(staffBehaviorThread, THREAD_STAFF);
+    double gridlockSeconds = boardingStats.gridlockUntil(simClock.now());
+    if (!deadlocked) {
+        // Patients still waiting are censored at the time the doctors stopped
+        lock_guard<OrderedMutex> lock(queueMutex);
+        auto stopTime = simClock.now();
+        for (auto& queued : queuedPatients) shutdownStats.censor(*queued.second, stopTime);
+        shutdownStats.stopSeconds = chrono::duration<double>(stopTime - horizonTime).count();
+    }
+    timers.stop();
+    shutdownStats.teardownMs = chrono::duration<double, milli>(chrono::steady_clock::now() - horizonWall).count();
+    liveView.resourcesChanged();
+    dashboard.stop();
+    liveView.close();
+    simClock.stopVirtual();
+
+    size_t records = eventLog.size();
+    uint64_t digest = eventLog.digest();
+    scheduleLog.finish(records, digest);
+    bool diverged = replaying && !scheduleLog.divergenceReason().empty();
+    if (recording) {
+        if (scheduleLog.save(config.recordSchedulePath, records, digest)) {
+            cout << "Schedule: " << scheduleLog.size() << " steps recorded to " << config.recordSchedulePath << endl;
+        } else {
+            cerr << "Cannot write schedule " << config.recordSchedulePath << endl;
+        }
+    }
+    if (replaying && !diverged) {
+        cout << "Replay followed all " << scheduleLog.size() << " recorded steps; the " << records
+             << " events match the recording" << endl;
+    } else if (diverged) {
+        cerr << "Replay diverged after " << scheduleLog.followed() << " of " << scheduleLog.size()
+             << " recorded steps: " << scheduleLog.divergenceReason() << endl;
+    }
+
+    if (!config.eventLogPath.empty()) {
+        if (eventLog.save(config.eventLogPath)) {
+            cout << "Event log: " << records << " records written to " << config.eventLogPath << endl;
+        } else {
+            cerr << "Cannot write event log " << config.eventLogPath << endl;
+        }
+    } else {
+        eventLog.close();
+    }
+
+    int deterioratedTotal = 0, eligibleTotal = 0;
+    for (int p = MEDIUM; p < PRIORITY_LEVELS; ++p) {
+        deterioratedTotal += patientsDeteriorated[p];
+        eligibleTotal += patientsArrived[p];
     }
-    patientThread.join();
-    resourceThread.join();
-    staffBehaviorThread.join();
+    if (deterioratedTotal > 0) {
+        cout << deterioratedTotal << " of " << eligibleTotal
+             << " Medium/Low patients deteriorated while waiting." << endl;
+    }
+    int abandonedTotal = patientsAbandoned[HIGH] + patientsAbandoned[MEDIUM] + patientsAbandoned[LOW];
+    if (abandonedTotal > 0) {
+        cout << abandonedTotal << " patient(s) left without being seen." << endl;
+    }
+    if (returnVisits > 0) {
+        cout << returnVisits << " return visit(s) from earlier discharges." << endl;
+    }
+    if (boardingStats.transfers > 0) {
+        cout << boardingStats.transfers << " admitted patient(s) transferred at the boarding cap." << endl;
+    }
+    if (gridlockSeconds > 0) {
+        cout << "ED gridlocked (boarders in every exam room) for " << gridlockSeconds << " s." << endl;
+    }
+    long long censoredTotal = shutdownStats.censored[HIGH] + shutdownStats.censored[MEDIUM] + shutdownStats.censored[LOW];
+    cout << "Shutdown (" << config.shutdown << "): " << shutdownStats.drained << " treatment(s) finished after the horizon, "
+         << shutdownStats.cutShort << " cut short, " << censoredTotal << " patient(s) never treated";
+    if (censoredTotal > 0) {
+        cout << " (censored: " << shutdownStats.censored[HIGH] << " High, " << shutdownStats.censored[MEDIUM]
+             << " Medium, " << shutdownStats.censored[LOW] << " Low; mean wait so far "
+             << shutdownStats.censoredWaitSeconds / censoredTotal << " s)";
+    }
+    cout << "; stopped " << shutdownStats.stopSeconds << " simulated s after the horizon, teardown "
+         << shutdownStats.teardownMs << " ms" << endl;
+    if (!virtualClock && !replaying) simClock.printLagReport();
 
     cout << "Hospital Emergency Room Simulation Ended." << endl;
+    if (deadlocked) cerr << "The run was stopped by a deadlock: threads were still blocked at the end" << endl;
+    return !deadlocked && !diverged;
+}
+
+// Function to render a live view file in the terminal until the run finishes.
+// Each frame is read from the mapping without a system call; only drawing
+// and the frame pacing sleep are syscalls.
+void runLiveViewer() {
+    int fd = open(config.liveViewPath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        cerr << "Cannot open live view " << config.liveViewPath << " (start the run with --liveView first)" << endl;
+        return;
+    }
+    void* memory = mmap(nullptr, sizeof(LiveViewFile), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        cerr << "Cannot map live view " << config.liveViewPath << endl;
+        return;
+    }
+    const LiveViewFile* file = (const LiveViewFile*)memory;
+    if (file->magic != LIVE_VIEW_MAGIC || file->layout != LIVE_VIEW_LAYOUT) {
+        cerr << config.liveViewPath << " is not a live view of this version" << endl;
+        munmap(memory, sizeof(LiveViewFile));
+        return;
+    }
+
+    auto framePeriod = chrono::duration_cast<chrono::steady_clock::duration>(
+        chrono::duration<double>(1.0 / max(config.liveViewFps, 1.0)));
+    auto next = chrono::steady_clock::now();
+    long long frames = 0, retries = 0;
+    LiveViewData data;
+    deque<LiveViewData> history;
+    while (true) {
+        uint64_t n = readLiveView(file, data, retries);
+        frames++;
+        cout << renderLiveView(data, rateBase(history, data), "  (frame " + to_string(n) + ", viewer " +
+                               to_string(frames) + " frames, " + to_string(retries) + " retries)") << flush;
+        if (data.finished) break;
+        next += framePeriod;
+        this_thread::sleep_until(next);
+    }
+    cout << "Run finished." << endl;
+    munmap(memory, sizeof(LiveViewFile));
+}
+
+// Cross-engine validation: the threaded mode on the virtual clock and the
+// discrete-event engine run the same scenario with the same seeds. The two
+// engines draw from different random streams, so they are compared as samples:
+// each replication yields one value per measure, and Welch's t-test checks
+// the replication means of the two engines against each other.
+enum ValidationMeasure {
+    V_ARRIVALS, V_THROUGHPUT, V_UTILIZATION, V_MEAN_WAIT, V_P90_WAIT, V_WAIT_HIGH, V_WAIT_MEDIUM, V_WAIT_LOW,
+    VALIDATION_MEASURES
+};
+const char* const VALIDATION_MEASURE_NAMES[VALIDATION_MEASURES] = {
+    "Arrivals/h", "Treated/h", "Utilization %", "Mean wait s", "p90 wait s", "High wait s", "Medium wait s",
+    "Low wait s"
+};
+
+// Measures of one replication from the waits (by triage priority) of the
+// treatments started inside the horizon
+template <typename T>
+array<double, VALIDATION_MEASURES> validationMeasures(const vector<T> (&waits)[PRIORITY_LEVELS], long long arrived,
+                                                      long long treated, double treatmentSeconds) {
+    array<double, VALIDATION_MEASURES> m{};
+    double hours = config.horizonSeconds / 3600;
+    m[V_ARRIVALS] = arrived / hours;
+    m[V_THROUGHPUT] = treated / hours;
+    m[V_UTILIZATION] = 100 * treatmentSeconds / (config.doctorThreads * config.horizonSeconds);
+    vector<double> all;
+    for (int p = 0; p < PRIORITY_LEVELS; ++p) {
+        double sum = 0;
+        for (T w : waits[p]) {
+            sum += w;
+            all.push_back(w);
+        }
+        m[V_WAIT_HIGH + p] = waits[p].empty() ? 0 : sum / waits[p].size();
+    }
+    if (!all.empty()) {
+        m[V_MEAN_WAIT] = accumulate(all.begin(), all.end(), 0.0) / all.size();
+        size_t k = (size_t)(0.9 * (all.size() - 1));
+        nth_element(all.begin(), all.begin() + k, all.end());
+        m[V_P90_WAIT] = all[k];
+    }
+    return m;
+}
+
+// Regularized incomplete beta function I_x(a, b), by Lentz's continued fraction
+double incompleteBeta(double a, double b, double x) {
+    if (x <= 0) return 0;
+    if (x >= 1) return 1;
+    if (x > (a + 1) / (a + b + 2)) return 1 - incompleteBeta(b, a, 1 - x);
+    double front = exp(lgamma(a + b) - lgamma(a) - lgamma(b) + a * log(x) + b * log(1 - x)) / a;
+    const double tiny = 1e-300;
+    double f = 1, c = 1, d = 0;
+    for (int i = 0; i <= 400; ++i) {
+        int m = i / 2;
+        double numerator;
+        if (i == 0) numerator = 1;
+        else if (i % 2 == 0) numerator = m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m));
+        else numerator = -(a + m) * (a + b + m) * x / ((a + 2 * m) * (a + 2 * m + 1));
+        d = 1 + numerator * d;
+        if (fabs(d) < tiny) d = tiny;
+        d = 1 / d;
+        c = 1 + numerator / c;
+        if (fabs(c) < tiny) c = tiny;
+        double cd = c * d;
+        f *= cd;
+        if (fabs(1 - cd) < 1e-12) break;
+    }
+    return front * (f - 1);
+}
+
+// Two-sided p-value of Welch's t-test on two samples given by mean, variance and size
+double welchPValue(double mean1, double var1, double n1, double mean2, double var2, double n2) {
+    double se1 = var1 / n1, se2 = var2 / n2;
+    if (se1 + se2 <= 0) return mean1 == mean2 ? 1 : 0;
+    double t = (mean1 - mean2) / sqrt(se1 + se2);
+    double df = (se1 + se2) * (se1 + se2) / (se1 * se1 / (n1 - 1) + se2 * se2 / (n2 - 1));
+    return incompleteBeta(df / 2, 0.5, df / (df + t * t));
+}
+
+// Function to run the cross-engine validation; returns false if a measure differs
+bool runValidation() {
+    if (!config.recordSchedulePath.empty() || !config.replaySchedulePath.empty() || !config.eventLogPath.empty()) {
+        cerr << "Validation runs the threaded mode on its own; drop recordSchedule, replaySchedule and eventLog" << endl;
+        return false;
+    }
+    int replications = max(config.validationReplications, 2);
+    unsigned int seed = config.seed != 0 ? config.seed : (unsigned int)time(0);
+    cout << "Cross-engine validation (seed " << seed << "): " << replications << " replications of "
+         << config.horizonSeconds / 3600 << " h per engine..." << endl;
+
+    SimConfig original = config;
+    config.clock = "virtual";
+    vector<array<double, VALIDATION_MEASURES>> threaded, des;
+    double threadedSeconds = 0, desSeconds = 0;
+    for (int r = 0; r < replications; ++r) {
+        config.seed = seed + r;
+
+        streambuf* out = cout.rdbuf(nullptr); // The threaded mode prints every step
+        auto start = chrono::steady_clock::now();
+        bool completed = runRealTime();
+        threadedSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout.rdbuf(out);
+        if (!completed) {
+            cerr << "Replication " << r + 1 << " of the threaded mode did not complete" << endl;
+            config = original;
+            return false;
+        }
+        threaded.push_back(validationMeasures(runStats.waitSeconds, runStats.arrived, runStats.treated,
+                                              runStats.treatmentSeconds));
+
+        start = chrono::steady_clock::now();
+        DiscreteEventSimulation sim(config, config.seed);
+        sim.run();
+        desSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        const DiscreteEventSimulation::Stats& s = sim.statistics();
+        des.push_back(validationMeasures(s.waitSamples, s.arrived[HIGH] + s.arrived[MEDIUM] + s.arrived[LOW],
+                                         s.treated[HIGH] + s.treated[MEDIUM] + s.treated[LOW], s.treatmentSeconds));
+    }
+    config = original;
+
+    // Bonferroni: the run fails if any measure differs at alpha / measures
+    double threshold = config.validationAlpha / VALIDATION_MEASURES;
+    bool agree = true;
+    cout << fixed << setprecision(2);
+    cout << setw(16) << "Measure" << setw(14) << "Threaded" << setw(10) << "+/-" << setw(14) << "DES"
+         << setw(10) << "+/-" << setw(12) << "Diff %" << setw(10) << "p" << endl;
+    for (int m = 0; m < VALIDATION_MEASURES; ++m) {
+        double mean[2] = {}, variance[2] = {};
+        const vector<array<double, VALIDATION_MEASURES>>* samples[2] = {&threaded, &des};
+        for (int e = 0; e < 2; ++e) {
+            for (const auto& x : *samples[e]) mean[e] += x[m];
+            mean[e] /= replications;
+            for (const auto& x : *samples[e]) variance[e] += (x[m] - mean[e]) * (x[m] - mean[e]);
+            variance[e] /= replications - 1;
+        }
+        double p = welchPValue(mean[0], variance[0], replications, mean[1], variance[1], replications);
+        bool differs = p < threshold;
+        agree = agree && !differs;
+        double diff = mean[1] != 0 ? 100 * (mean[0] - mean[1]) / mean[1] : 0;
+        cout << setw(16) << VALIDATION_MEASURE_NAMES[m] << setw(14) << mean[0]
+             << setw(10) << 1.96 * sqrt(variance[0] / replications) << setw(14) << mean[1]
+             << setw(10) << 1.96 * sqrt(variance[1] / replications) << setw(12) << diff
+             << setw(10) << setprecision(4) << p << setprecision(2) << (differs ? "  DIFFERS" : "") << endl;
+    }
+    double simulated = config.horizonSeconds * replications;
+    cout << "Threaded (virtual clock): " << threadedSeconds << " s, " << simulated / max(threadedSeconds, 1e-9)
+         << "x real time" << endl;
+    cout << "Discrete-event: " << desSeconds << " s, " << simulated / max(desSeconds, 1e-9) << "x real time" << endl;
+    cout << "Speedup of the discrete-event engine: " << threadedSeconds / max(desSeconds, 1e-9) << "x" << endl;
+    cout << (agree ? "Engines agree" : "Engines disagree") << " (alpha " << config.validationAlpha
+         << ", Bonferroni over " << VALIDATION_MEASURES << " measures)" << endl;
+    cout << defaultfloat;
+    return agree;
+}
+
+// Main function
+int main(int argc, char* argv[]) {
+    if (!parseArguments(config, argc, argv)) return 1;
+
+    if (config.clock != "real" && config.clock != "virtual") {
+        cerr << "Unknown clock " << config.clock << " (expected real or virtual)" << endl;
+        return 1;
+    }
+    if (config.shutdown != "drain" && config.shutdown != "abort") {
+        cerr << "Unknown shutdown " << config.shutdown << " (expected drain or abort)" << endl;
+        return 1;
+    }
+    if (config.clockSpeed <= 0) {
+        cerr << "clockSpeed must be positive" << endl;
+        return 1;
+    }
+    // Every mode that runs the hospital model needs a configuration it can run;
+    // the sweep checks each of its points instead
+    const string modelModes[] = {"des",           "realtime",        "lockstep", "replicate", "farm",
+                                 "bench-pinning", "bench-hugepages", "validate", "splitting"};
+    string error;
+    if (find(begin(modelModes), end(modelModes), config.mode) != end(modelModes) && !checkConfig(config, error)) {
+        cerr << "Invalid configuration: " << error << endl;
+        return 1;
+    }
+    HugePageArena::mode = max(hugePageMode(config.hugePages), (int)HUGE_PAGES_OFF);
+
+    if (config.mode == "des") {
+        runDiscreteEvent();
+    } else if (config.mode == "realtime") {
+        if (!runRealTime()) return 1;
+    } else if (config.mode == "replay") {
+        runReplay();
+    } else if (config.mode == "view") {
+        runLiveViewer();
+    } else if (config.mode == "lockstep") {
+        runLockstep();
+    } else if (config.mode == "bench-fel") {
+        runEventListBenchmark();
+    } else if (config.mode == "replicate") {
+        if (!runParallelReplications()) return 1;
+    } else if (config.mode == "farm") {
+        if (!runReplicationFarm()) return 1;
+    } else if (config.mode == "bench-pinning") {
+        if (!runPinningBenchmark()) return 1;
+    } else if (config.mode == "bench-hugepages") {
+        runHugePageBenchmark();
+    } else if (config.mode == "bench-workers") {
+        runWorkerBenchmark();
+    } else if (config.mode == "validate") {
+        if (!runValidation()) return 1;
+    } else if (config.mode == "splitting") {
+        if (!runImportanceSplitting()) return 1;
+    } else if (config.mode == "sweep") {
+        if (!runSweep()) return 1;
+    } else {
+        cerr << "Unknown mode " << config.mode << " (expected realtime, des, replay, view, lockstep, replicate, farm, bench-fel, bench-workers, "
+                "bench-pinning, bench-hugepages, validate, splitting or sweep)" << endl;
+        return 1;
+    }
     return 0;
 }
@@ -0,0 +1,217 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+// Public interface of the simulation library: the model configuration and the
+// discrete-event engine as a reusable object. The command-line program
+// (Simulation.cpp) is one client; optimizers and test harnesses can link the
+// library and run the model in-process.
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Priority Levels
+enum Priority { HIGH, MEDIUM, LOW };
+const int PRIORITY_LEVELS = 3;
+
+// Simulation parameters. The defaults reproduce the original hard-coded model,
+// a scenario file or --key=value options override them.
+struct SimConfig {
+    std::string mode = "realtime";     // realtime | des | replay | view | lockstep | replicate | farm | validate | splitting | sweep | bench-*
+    std::string eventList = "tiered";  // future event list: tiered | calendar | heap | pairing | radix
+    std::string hugePages = "off";     // DES arenas: off | transparent | explicit (HugePageArena), per Simulation object
+    unsigned int seed = 0;             // 0 = seed from the clock
+    double horizonSeconds = 30;
+    std::string clock = "real";        // realtime mode: real | virtual (SimulationClock)
+    double clockSpeed = 1;             // real clock: simulated seconds per wall second
+    std::string liveViewPath;          // realtime: publish a LiveView here; --mode=view renders it
+    double liveViewFps = 60;
+    std::string display = "lines";     // realtime: lines (one per event) | dashboard
+    double dashboardHz = 4;
+    double lagToleranceMs = 50;        // real clock: wake-ups later than this count as lag
+    std::string shutdown = "drain";    // realtime, at the horizon: drain (finish the queue) | abort (ShutdownStats)
+    double drainSeconds = 30;          // drain: simulated deadline after the horizon
+
+    int doctors = 3;
+    int nurses = 2;
+    int examRooms = 2;
+    int ventilators = 1;
+    int doctorThreads = 3;             // doctors actively pulling patients
+
+    int arrivalMinSeconds = 1;
+    int arrivalMaxSeconds = 5;
+    double treatmentSeconds = 2;
+
+    bool dynamicResources = true;
+    double resourceIntervalSeconds = 10;
+    bool staffBreaks = true;
+    double breakIntervalSeconds = 20;
+    double breakDurationSeconds = 5;
+
+    // Disposition: share of treated patients admitted to an inpatient ward
+    double admitProbability[PRIORITY_LEVELS] = {0.0, 0.0, 0.0};
+    int wardBeds = 0;
+    double wardStayMeanDays = 3.0;
+    int maxBoarders = 0;               // admitted patients boarding in the ED at most; more are transferred (0 = no cap)
+
+    // Equipment failures (exponential time between failures, 0 = never fails),
+    // lognormal repairs, and periodic maintenance windows per unit
+    double ventilatorMtbfHours = 0;
+    double ventilatorMttrHours = 4;
+    double ventilatorMaintenanceIntervalHours = 0;
+    double ventilatorMaintenanceHours = 2;
+    double roomMtbfHours = 0;
+    double roomMttrHours = 1;
+    double roomMaintenanceIntervalHours = 0;
+    double roomMaintenanceHours = 1;
+    double repairCv = 0.5;             // coefficient of variation of repair times
+
+    // Mean time until a waiting MEDIUM or LOW patient deteriorates by one
+    // priority level (exponential, 0 = never)
+    double deteriorationMeanMinutes[PRIORITY_LEVELS] = {0.0, 0.0, 0.0};
+
+    // Mean patience before a waiting patient leaves without being seen
+    // (exponential, 0 = never leaves)
+    double abandonMeanMinutes[PRIORITY_LEVELS] = {0.0, 0.0, 0.0};
+
+    // Return visits after discharge from the ED: base probability per priority,
+    // raised by returnWaitFactorPerHour for every hour the patient waited
+    double returnProbability[PRIORITY_LEVELS] = {0.0, 0.0, 0.0};
+    double returnWaitFactorPerHour = 0.0;
+    double returnDelayMeanDays = 3.0;
+
+    // Lockstep staffing screen (--mode=lockstep): independent replications of
+    // the Markovian core model, advanced lockstepLanes at a time
+    int replications = 1000;
+    int lockstepLanes = 16;            // 1, 8 or 16
+
+    // Parallel discrete-event replications (--mode=replicate, bench-pinning),
+    // also `replications` runs; workers are pinned round-robin over NUMA nodes
+    int workerThreads = 0;             // 0 = every allowed CPU
+    bool pinThreads = true;
+    int benchRounds = 3;
+    int farmProcesses = 0;             // --mode=farm worker processes, 0 = hardware threads
+
+    // Rare-event estimation of ventilator shortages (--mode=splitting):
+    // trajectories per stage and the danger levels of ventilatorPressure,
+    // comma-separated and increasing (empty = 1 up to the ventilators)
+    int splittingEffort = 1000;
+    std::string splittingLevels;
+    bool splittingCompare = true;      // also run plain Monte Carlo on the same event budget
+
+    // Experiment design over input ranges (--mode=sweep): "key=low:high,..."
+    // for any option, sobol | lhs points, replications per point, CSV output
+    std::string sweepFactors = "nurses=1:6,examRooms=1:6,ventilators=1:4,arrivalMaxSeconds=2:10,treatmentSeconds=1:8";
+    std::string sweepDesign = "sobol";
+    int sweepPoints = 256;
+    int sweepReplications = 1;
+    std::string sweepOutput = "sweep.csv";
+
+    // Event log of the threaded mode: written by realtime runs, read by
+    // --mode=replay, which rebuilds the state at replayAtSeconds (-1 = end)
+    std::string eventLogPath;
+    double replayAtSeconds = -1;
+
+    // Cross-engine validation (--mode=validate): threaded mode on the virtual
+    // clock against the discrete-event engine, one seed per replication
+    int validationReplications = 20;
+    double validationAlpha = 0.01;
+
+    // Record/replay of the threaded mode's thread interleaving (ScheduleLog)
+    std::string recordSchedulePath;
+    std::string replaySchedulePath;
+
+    // Pathway overrides, "State, Event -> State : action" (see PatientPathway)
+    std::vector<std::string> transitions;
+
+    // Event list benchmark (--mode=bench-fel)
+    size_t benchHolds = 1000000;
+    size_t benchMaxPending = 1000000;
+
+    // Worker scaling benchmark (--mode=bench-workers): thread per clinician
+    // against a pooled executor, for each clinician count in the list
+    std::string benchWorkers = "3,10,100,1000,10000";
+    double benchWorkerSeconds = 2;
+    double benchTreatmentMs = 200;
+    double benchLoad = 0.8;
+    int benchPoolThreads = 0;          // 0 = hardware threads
+};
+
+// Function to set one configuration value; returns false for unknown keys
+bool applyOption(SimConfig& cfg, const std::string& key, const std::string& value);
+
+// Function to load a scenario file of "key = value" lines ('#' starts a comment)
+bool loadScenario(SimConfig& cfg, const std::string& path);
+
+// Function to check that the discrete-event engine can run a configuration
+// (counts of at least one, arrivalMinSeconds <= arrivalMaxSeconds,
+// probabilities in [0, 1], known event list and pathway, ...); returns false
+// and sets error otherwise
+bool checkConfig(const SimConfig& cfg, std::string& error);
+
+// Results of one discrete-event run over the horizon
+struct SimulationResults {
+    double simulatedSeconds = 0;
+    long long eventsProcessed = 0;
+    long long arrived[PRIORITY_LEVELS] = {};
+    long long treated[PRIORITY_LEVELS] = {};
+    long long admitted[PRIORITY_LEVELS] = {};
+    long long abandoned[PRIORITY_LEVELS] = {};   // left without being seen
+    double meanWaitSeconds[PRIORITY_LEVELS] = {}; // of treated patients, by triage priority
+    double maxWaitSeconds[PRIORITY_LEVELS] = {};
+    double meanQueueLength = 0;
+    double meanWardOccupancy = 0;
+    long long boarded = 0;
+    long long transfers = 0;
+    double gridlockSeconds = 0;                   // time boarders held every exam room
+    long long ventilatorShortages = 0;
+    int stillWaiting = 0;                         // at the horizon
+};
+
+// The discrete-event engine as an object: configure once, then run any
+// number of replications, each from a fresh state and its own seed:
+//
+//     std::string error;
+//     std::unique_ptr<Simulation> sim = Simulation::create(config, error);
+//     for (unsigned int seed = 1; seed <= 1000; ++seed) {
+//         sim->reset(seed);
+//         const SimulationResults& r = sim->run();
+//     }
+//
+// reset() keeps the memory of the previous run (event list, patient arrays,
+// queues, samples), so a replication after the first allocates next to
+// nothing. One object must only be used by one thread at a time. Separate
+// objects share no state and can run concurrently. A run with the same
+// configuration and seed gives the same results, whether the object is new
+// or reused.
+class Simulation {
+public:
+    // Returns nullptr and sets error if the configuration is invalid
+    // (see checkConfig)
+    static std::unique_ptr<Simulation> create(const SimConfig& config, std::string& error);
+    ~Simulation();
+
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+
+    // Replaces the configuration, keeping the allocated memory where it can;
+    // on error the object keeps its previous configuration
+    bool reconfigure(const SimConfig& config, std::string& error);
+
+    // Returns to time zero with a new seed
+    void reset(unsigned int seed);
+
+    // Runs to the horizon; after that, returns the same results until reset()
+    const SimulationResults& run();
+
+    const SimulationResults& results() const;
+    const SimConfig& configuration() const;
+
+private:
+    struct Engine;
+    explicit Simulation(std::unique_ptr<Engine> engine);
+    std::unique_ptr<Engine> engine;
+};
+
+#endif
@@ -0,0 +1,273 @@
+#include <iostream>
+
+#include "Simulation.h"
+#include "SimulationEngine.h"
+
+using namespace std;
+
+atomic<int> HugePageArena::mode(HUGE_PAGES_OFF);
+thread_local int HugePageArena::scopedMode = -1;
+HugePageArena::Metrics HugePageArena::metrics;
+
+// Function to set one configuration value; returns false for unknown keys
+bool applyOption(SimConfig& cfg, const string& key, const string& value) {
+    try {
+        if (key == "mode") cfg.mode = value;
+        else if (key == "eventList") cfg.eventList = value;
+        else if (key == "clock") cfg.clock = value;
+        else if (key == "hugePages") cfg.hugePages = value;
+        else if (key == "clockSpeed") cfg.clockSpeed = stod(value);
+        else if (key == "liveView") cfg.liveViewPath = value;
+        else if (key == "liveViewFps") cfg.liveViewFps = stod(value);
+        else if (key == "display") cfg.display = value;
+        else if (key == "shutdown") cfg.shutdown = value;
+        else if (key == "drainSeconds") cfg.drainSeconds = stod(value);
+        else if (key == "dashboardHz") cfg.dashboardHz = stod(value);
+        else if (key == "lagToleranceMs") cfg.lagToleranceMs = stod(value);
+        else if (key == "recordSchedule") cfg.recordSchedulePath = value;
+        else if (key == "replaySchedule") cfg.replaySchedulePath = value;
+        else if (key == "eventLog") cfg.eventLogPath = value;
+        else if (key == "replayAtSeconds") cfg.replayAtSeconds = stod(value);
+        else if (key == "transition") cfg.transitions.push_back(value);
+        else if (key == "replications") cfg.replications = stoi(value);
+        else if (key == "validationReplications") cfg.validationReplications = stoi(value);
+        else if (key == "validationAlpha") cfg.validationAlpha = stod(value);
+        else if (key == "lockstepLanes") cfg.lockstepLanes = stoi(value);
+        else if (key == "workerThreads") cfg.workerThreads = stoi(value);
+        else if (key == "pinThreads") cfg.pinThreads = (value == "1" || value == "true");
+        else if (key == "benchRounds") cfg.benchRounds = stoi(value);
+        else if (key == "farmProcesses") cfg.farmProcesses = stoi(value);
+        else if (key == "splittingEffort") cfg.splittingEffort = stoi(value);
+        else if (key == "splittingLevels") cfg.splittingLevels = value;
+        else if (key == "splittingCompare") cfg.splittingCompare = (value == "1" || value == "true");
+        else if (key == "sweepFactors") cfg.sweepFactors = value;
+        else if (key == "sweepDesign") cfg.sweepDesign = value;
+        else if (key == "sweepPoints") cfg.sweepPoints = stoi(value);
+        else if (key == "sweepReplications") cfg.sweepReplications = stoi(value);
+        else if (key == "sweepOutput") cfg.sweepOutput = value;
+        else if (key == "benchHolds") cfg.benchHolds = stoul(value);
+        else if (key == "benchMaxPending") cfg.benchMaxPending = stoul(value);
+        else if (key == "benchWorkers") cfg.benchWorkers = value;
+        else if (key == "benchWorkerSeconds") cfg.benchWorkerSeconds = stod(value);
+        else if (key == "benchTreatmentMs") cfg.benchTreatmentMs = stod(value);
+        else if (key == "benchLoad") cfg.benchLoad = stod(value);
+        else if (key == "benchPoolThreads") cfg.benchPoolThreads = stoi(value);
+        else if (key == "seed") cfg.seed = (unsigned int)stoul(value);
+        else if (key == "horizonSeconds") cfg.horizonSeconds = stod(value);
+        else if (key == "horizonDays") cfg.horizonSeconds = stod(value) * 24 * 60 * 60;
+        else if (key == "doctors") cfg.doctors = stoi(value);
+        else if (key == "nurses") cfg.nurses = stoi(value);
+        else if (key == "examRooms") cfg.examRooms = stoi(value);
+        else if (key == "ventilators") cfg.ventilators = stoi(value);
+        else if (key == "doctorThreads") cfg.doctorThreads = stoi(value);
+        else if (key == "arrivalMinSeconds") cfg.arrivalMinSeconds = stoi(value);
+        else if (key == "arrivalMaxSeconds") cfg.arrivalMaxSeconds = stoi(value);
+        else if (key == "treatmentSeconds") cfg.treatmentSeconds = stod(value);
+        else if (key == "dynamicResources") cfg.dynamicResources = (value == "1" || value == "true");
+        else if (key == "resourceIntervalSeconds") cfg.resourceIntervalSeconds = stod(value);
+        else if (key == "staffBreaks") cfg.staffBreaks = (value == "1" || value == "true");
+        else if (key == "breakIntervalSeconds") cfg.breakIntervalSeconds = stod(value);
+        else if (key == "breakDurationSeconds") cfg.breakDurationSeconds = stod(value);
+        else if (key == "admitProbabilityHigh") cfg.admitProbability[HIGH] = stod(value);
+        else if (key == "admitProbabilityMedium") cfg.admitProbability[MEDIUM] = stod(value);
+        else if (key == "admitProbabilityLow") cfg.admitProbability[LOW] = stod(value);
+        else if (key == "wardBeds") cfg.wardBeds = stoi(value);
+        else if (key == "wardStayMeanDays") cfg.wardStayMeanDays = stod(value);
+        else if (key == "maxBoarders") cfg.maxBoarders = stoi(value);
+        else if (key == "ventilatorMtbfHours") cfg.ventilatorMtbfHours = stod(value);
+        else if (key == "ventilatorMttrHours") cfg.ventilatorMttrHours = stod(value);
+        else if (key == "ventilatorMaintenanceIntervalHours") cfg.ventilatorMaintenanceIntervalHours = stod(value);
+        else if (key == "ventilatorMaintenanceHours") cfg.ventilatorMaintenanceHours = stod(value);
+        else if (key == "roomMtbfHours") cfg.roomMtbfHours = stod(value);
+        else if (key == "roomMttrHours") cfg.roomMttrHours = stod(value);
+        else if (key == "roomMaintenanceIntervalHours") cfg.roomMaintenanceIntervalHours = stod(value);
+        else if (key == "roomMaintenanceHours") cfg.roomMaintenanceHours = stod(value);
+        else if (key == "repairCv") cfg.repairCv = stod(value);
+        else if (key == "deteriorationMeanMinutesMedium") cfg.deteriorationMeanMinutes[MEDIUM] = stod(value);
+        else if (key == "deteriorationMeanMinutesLow") cfg.deteriorationMeanMinutes[LOW] = stod(value);
+        else if (key == "abandonMeanMinutesHigh") cfg.abandonMeanMinutes[HIGH] = stod(value);
+        else if (key == "abandonMeanMinutesMedium") cfg.abandonMeanMinutes[MEDIUM] = stod(value);
+        else if (key == "abandonMeanMinutesLow") cfg.abandonMeanMinutes[LOW] = stod(value);
+        else if (key == "returnProbabilityHigh") cfg.returnProbability[HIGH] = stod(value);
+        else if (key == "returnProbabilityMedium") cfg.returnProbability[MEDIUM] = stod(value);
+        else if (key == "returnProbabilityLow") cfg.returnProbability[LOW] = stod(value);
+        else if (key == "returnWaitFactorPerHour") cfg.returnWaitFactorPerHour = stod(value);
+        else if (key == "returnDelayMeanDays") cfg.returnDelayMeanDays = stod(value);
+        else return false;
+    } catch (const exception&) {
+        cerr << "Invalid value for " << key << ": " << value << endl;
+        return false;
+    }
+    return true;
+}
+
+// Function to load a scenario file of "key = value" lines ('#' starts a comment)
+bool loadScenario(SimConfig& cfg, const string& path) {
+    ifstream in(path);
+    if (!in) {
+        cerr << "Cannot open scenario file " << path << endl;
+        return false;
+    }
+    string line;
+    int lineNumber = 0;
+    while (getline(in, line)) {
+        ++lineNumber;
+        line = line.substr(0, line.find('#'));
+        size_t eq = line.find('=');
+        if (eq == string::npos) {
+            if (line.find_first_not_of(" \t\r") != string::npos) {
+                cerr << path << ":" << lineNumber << ": expected key = value" << endl;
+                return false;
+            }
+            continue;
+        }
+        auto trim = [](string s) {
+            size_t first = s.find_first_not_of(" \t\r");
+            size_t last = s.find_last_not_of(" \t\r");
+            return first == string::npos ? string() : s.substr(first, last - first + 1);
+        };
+        string key = trim(line.substr(0, eq));
+        string value = trim(line.substr(eq + 1));
+        if (!applyOption(cfg, key, value)) {
+            cerr << path << ":" << lineNumber << ": unknown option " << key << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+struct Simulation::Engine {
+    SimConfig config;
+    DiscreteEventSimulation sim; // reads config by reference
+    SimulationResults results;
+    bool finished = false;
+
+    explicit Engine(const SimConfig& cfg) : config(cfg), sim(config, cfg.seed) {}
+};
+
+bool checkConfig(const SimConfig& config, string& error) {
+    // Values that would give a distribution an invalid range or parameter, or
+    // leave a pool the engine draws from empty
+    ostringstream problem;
+    const char* levels[PRIORITY_LEVELS] = {"High", "Medium", "Low"};
+    if (!(config.horizonSeconds > 0)) problem << "horizonSeconds must be positive";
+    else if (config.doctors < 1) problem << "doctors must be at least 1, got " << config.doctors;
+    else if (config.doctorThreads < 1) problem << "doctorThreads must be at least 1, got " << config.doctorThreads;
+    else if (config.nurses < 1) problem << "nurses must be at least 1, got " << config.nurses;
+    else if (config.examRooms < 1) problem << "examRooms must be at least 1, got " << config.examRooms;
+    else if (config.ventilators < 0) problem << "ventilators cannot be negative, got " << config.ventilators;
+    else if (config.wardBeds < 0) problem << "wardBeds cannot be negative, got " << config.wardBeds;
+    else if (config.maxBoarders < 0) problem << "maxBoarders cannot be negative, got " << config.maxBoarders;
+    else if (config.arrivalMinSeconds < 0) problem << "arrivalMinSeconds cannot be negative, got " << config.arrivalMinSeconds;
+    else if (config.arrivalMaxSeconds < max(config.arrivalMinSeconds, 1))
+        problem << "arrivalMaxSeconds must be at least 1 and arrivalMinSeconds (" << config.arrivalMinSeconds << "), got "
+                << config.arrivalMaxSeconds;
+    else if (!(config.treatmentSeconds > 0)) problem << "treatmentSeconds must be positive";
+    else if (config.dynamicResources && !(config.resourceIntervalSeconds > 0))
+        problem << "resourceIntervalSeconds must be positive";
+    else if (config.staffBreaks && (!(config.breakIntervalSeconds > 0) || config.breakDurationSeconds < 0))
+        problem << "breakIntervalSeconds must be positive and breakDurationSeconds not negative";
+    else if (!(config.wardStayMeanDays > 0) || !(config.returnDelayMeanDays > 0))
+        problem << "wardStayMeanDays and returnDelayMeanDays must be positive";
+    else if (config.ventilatorMtbfHours < 0 || config.roomMtbfHours < 0 || config.ventilatorMaintenanceIntervalHours < 0 ||
+             config.roomMaintenanceIntervalHours < 0)
+        problem << "mean times between failures and maintenance intervals cannot be negative";
+    else if (!(config.ventilatorMttrHours > 0) || !(config.roomMttrHours > 0) || !(config.ventilatorMaintenanceHours > 0) ||
+             !(config.roomMaintenanceHours > 0) || config.repairCv < 0)
+        problem << "repair and maintenance times must be positive and repairCv not negative";
+    else if (config.returnWaitFactorPerHour < 0) problem << "returnWaitFactorPerHour cannot be negative";
+    for (int p = 0; p < PRIORITY_LEVELS && problem.tellp() == 0; ++p) {
+        if (!(config.admitProbability[p] >= 0 && config.admitProbability[p] <= 1))
+            problem << "admitProbability" << levels[p] << " must be between 0 and 1";
+        else if (!(config.returnProbability[p] >= 0 && config.returnProbability[p] <= 1))
+            problem << "returnProbability" << levels[p] << " must be between 0 and 1";
+        else if (config.deteriorationMeanMinutes[p] < 0 || config.abandonMeanMinutes[p] < 0)
+            problem << "deteriorationMeanMinutes" << levels[p] << " and abandonMeanMinutes" << levels[p]
+                    << " cannot be negative";
+    }
+    if (problem.tellp() > 0) {
+        error = problem.str();
+        return false;
+    }
+
+    if (!makeFutureEventList<DiscreteEventSimulation::Event>(config.eventList)) {
+        error = "unknown event list " + config.eventList;
+        return false;
+    }
+    if (hugePageMode(config.hugePages) < 0) {
+        error = "unknown hugePages " + config.hugePages + " (expected off, transparent or explicit)";
+        return false;
+    }
+    PatientPathway pathway;
+    if (!pathway.compile(config.transitions, error)) {
+        error = "pathway: " + error;
+        return false;
+    }
+    return true;
+}
+
+unique_ptr<Simulation> Simulation::create(const SimConfig& config, string& error) {
+    if (!checkConfig(config, error)) return nullptr;
+    HugePageScope pages(hugePageMode(config.hugePages));
+    return unique_ptr<Simulation>(new Simulation(unique_ptr<Engine>(new Engine(config))));
+}
+
+Simulation::Simulation(unique_ptr<Engine> engine) : engine(move(engine)) {}
+
+Simulation::~Simulation() = default;
+
+bool Simulation::reconfigure(const SimConfig& config, string& error) {
+    if (!checkConfig(config, error)) return false;
+    HugePageScope pages(hugePageMode(config.hugePages));
+    bool sameEventList = config.eventList == engine->config.eventList;
+    bool samePathway = config.transitions == engine->config.transitions;
+    engine->config = config;
+    if (!sameEventList || !samePathway) engine->sim.configure();
+    reset(config.seed);
+    return true;
+}
+
+void Simulation::reset(unsigned int seed) {
+    HugePageScope pages(hugePageMode(engine->config.hugePages));
+    engine->sim.reset(seed);
+    engine->results = SimulationResults();
+    engine->finished = false;
+}
+
+const SimulationResults& Simulation::run() {
+    if (engine->finished) return engine->results;
+    HugePageScope pages(hugePageMode(engine->config.hugePages));
+    DiscreteEventSimulation& sim = engine->sim;
+    sim.run();
+    engine->finished = true;
+
+    const DiscreteEventSimulation::Stats& s = sim.statistics();
+    SimTime end = sim.currentTime();
+    SimulationResults& r = engine->results;
+    r.simulatedSeconds = ticksToSeconds(end);
+    r.eventsProcessed = s.eventsProcessed;
+    for (int p = 0; p < PRIORITY_LEVELS; ++p) {
+        r.arrived[p] = s.arrived[p];
+        r.treated[p] = s.treated[p];
+        r.admitted[p] = s.admitted[p];
+        r.abandoned[p] = s.abandoned[p];
+        r.meanWaitSeconds[p] = s.treated[p] > 0 ? s.waitSeconds[p] / s.treated[p] : 0.0;
+        r.maxWaitSeconds[p] = s.maxWaitSeconds[p];
+    }
+    r.meanQueueLength = s.queueLength.mean(end);
+    r.meanWardOccupancy = s.wardOccupancy.mean(end);
+    r.boarded = s.boarded;
+    r.transfers = s.transfers;
+    r.gridlockSeconds = s.gridlock.mean(end) * ticksToSeconds(end);
+    r.ventilatorShortages = s.ventilatorShortages;
+    r.stillWaiting = sim.waitingPatients();
+    return r;
+}
+
+const SimulationResults& Simulation::results() const {
+    return engine->results;
+}
+
+const SimConfig& Simulation::configuration() const {
+    return engine->config;
+}
@@ -0,0 +1,1841 @@
+#ifndef SIMULATION_ENGINE_H
+#define SIMULATION_ENGINE_H
+
+// Internals of the discrete-event engine shared by the library
+// (SimulationEngine.cpp) and the command-line program: the future event
+// lists, the patient queue and pathway, the huge-page arena and the engine
+// itself. Not part of the public interface (Simulation.h).
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <new>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/mman.h>
+
+#include "Simulation.h"
+
+// Simulation time in the discrete-event mode, in integer milliseconds so that
+// horizons of several weeks stay exact
+typedef long long SimTime;
+const SimTime TICKS_PER_SECOND = 1000;
+const SimTime TICKS_PER_DAY = 24 * 60 * 60 * TICKS_PER_SECOND;
+
+inline SimTime secondsToTicks(double seconds) {
+    return (SimTime)(seconds * TICKS_PER_SECOND + 0.5);
+}
+
+inline double ticksToSeconds(SimTime ticks) {
+    return (double)ticks / TICKS_PER_SECOND;
+}
+
+// Probability that a patient discharged from the ED comes back
+inline double returnVisitProbability(const SimConfig& cfg, Priority priority, double waitSeconds) {
+    double p = cfg.returnProbability[priority] * (1.0 + cfg.returnWaitFactorPerHour * waitSeconds / 3600.0);
+    return std::min(p, 1.0);
+}
+
+// Lognormal duration with the given mean and coefficient of variation, from a
+// standard normal sample
+inline double lognormalFromNormal(double mean, double cv, double z) {
+    double sigma2 = std::log(1.0 + cv * cv);
+    return std::exp(std::log(mean) - sigma2 / 2 + std::sqrt(sigma2) * z);
+}
+
+// Priority queue of waiting patients that can also re-prioritize or remove a
+// patient in O(log n). Patients are addressed by a small integer handle
+// (patient id or record slot) that indexes the position table.
+class PatientQueue {
+public:
+    struct Entry {
+        Priority priority;
+        int id;
+        int handle;
+    };
+
+private:
+    std::vector<Entry> heap;
+    std::vector<int> position; // heap index per handle, -1 if not queued
+    int counts[PRIORITY_LEVELS] = {};
+
+    // Compare function for the heap
+    static bool before(const Entry& a, const Entry& b) {
+        if (a.priority == b.priority) {
+            return a.id < b.id; // First-Come, First-Served for same priority
+        }
+        return a.priority < b.priority; // Higher priority comes first
+    }
+
+    void place(size_t i) {
+        position[heap[i].handle] = (int)i;
+    }
+
+    void siftUp(size_t i) {
+        while (i > 0) {
+            size_t parent = (i - 1) / 2;
+            if (!before(heap[i], heap[parent])) break;
+            std::swap(heap[i], heap[parent]);
+            place(i);
+            i = parent;
+        }
+        place(i);
+    }
+
+    void siftDown(size_t i) {
+        while (true) {
+            size_t best = i;
+            size_t left = 2 * i + 1, right = 2 * i + 2;
+            if (left < heap.size() && before(heap[left], heap[best])) best = left;
+            if (right < heap.size() && before(heap[right], heap[best])) best = right;
+            if (best == i) break;
+            std::swap(heap[i], heap[best]);
+            place(i);
+            i = best;
+        }
+        place(i);
+    }
+
+public:
+    bool empty() const { return heap.empty(); }
+    size_t size() const { return heap.size(); }
+    const Entry& top() const { return heap.front(); }
+    int waitingAt(Priority priority) const { return counts[priority]; }
+
+    bool contains(int handle) const {
+        return handle >= 0 && handle < (int)position.size() && position[handle] >= 0;
+    }
+
+    void push(int handle, int id, Priority priority) {
+        if (handle >= (int)position.size()) position.resize(handle + 1, -1);
+        heap.push_back({priority, id, handle});
+        counts[priority]++;
+        siftUp(heap.size() - 1);
+    }
+
+    void pop() {
+        remove(heap.front().handle);
+    }
+
+    void remove(int handle) {
+        size_t i = position[handle];
+        position[handle] = -1;
+        counts[heap[i].priority]--;
+        if (i + 1 < heap.size()) {
+            heap[i] = heap.back();
+            heap.pop_back();
+            if (i > 0 && before(heap[i], heap[(i - 1) / 2])) siftUp(i); else siftDown(i);
+        } else {
+            heap.pop_back();
+        }
+    }
+
+    void reprioritize(int handle, Priority priority) {
+        size_t i = position[handle];
+        Priority old = heap[i].priority;
+        heap[i].priority = priority;
+        counts[old]--;
+        counts[priority]++;
+        if (priority < old) siftUp(i); else siftDown(i);
+    }
+
+    void clear() {
+        heap.clear();
+        position.clear();
+        std::fill(counts, counts + PRIORITY_LEVELS, 0);
+    }
+};
+
+// Inpatient ward: a pool of beds plus the ED patients boarding for one.
+// Boarders keep their exam room until a bed frees up.
+class Ward {
+private:
+    int bedsFree = 0;
+    std::deque<int> boarders;
+
+public:
+    void reset(int beds) {
+        bedsFree = beds;
+        boarders.clear();
+    }
+
+    // Returns true if the patient got a bed, false if they board in the ED
+    bool admit(int patientId) {
+        if (bedsFree > 0) {
+            --bedsFree;
+            return true;
+        }
+        boarders.push_back(patientId);
+        return false;
+    }
+
+    // Frees a bed; returns the boarder moved into it, or -1 if nobody was waiting
+    int discharge() {
+        if (!boarders.empty()) {
+            int patientId = boarders.front();
+            boarders.pop_front();
+            return patientId;
+        }
+        ++bedsFree;
+        return -1;
+    }
+
+    int freeBeds() const { return bedsFree; }
+    int boarding() const { return (int)boarders.size(); }
+};
+
+// Backing store for the large arrays of the discrete-event engine (event
+// lists and patient components). Blocks of 2 MB or more are mapped directly
+// and rounded to whole 2 MB pages, so a run with millions of pending events or
+// patients can sit on huge pages and take far fewer TLB misses:
+//   off         - plain anonymous mappings, as malloc would make;
+//   transparent - 2 MB-aligned mappings advised with MADV_HUGEPAGE;
+//   explicit    - MAP_HUGETLB pages from the reserved pool, falling back to
+//                 transparent when the pool is empty or not configured.
+// Smaller blocks come from operator new in every mode.
+enum HugePageMode { HUGE_PAGES_OFF, HUGE_PAGES_TRANSPARENT, HUGE_PAGES_EXPLICIT };
+
+class HugePageArena {
+public:
+    static const size_t PAGE = 2 * 1024 * 1024;
+
+    // Bytes mapped since the start, by kind of mapping, and bytes still mapped
+    struct Metrics {
+        std::atomic<long long> explicitBytes{0};
+        std::atomic<long long> advisedBytes{0};
+        std::atomic<long long> plainBytes{0};
+        std::atomic<long long> explicitFallbacks{0};  // MAP_HUGETLB requests that failed
+        std::atomic<long long> liveBytes{0};
+    };
+
+    static std::atomic<int> mode;     // process-wide default, set by main from hugePages
+    static thread_local int scopedMode; // overrides mode on this thread unless -1 (HugePageScope)
+    static Metrics metrics;
+
+    static int currentMode() { return scopedMode >= 0 ? scopedMode : mode.load(); }
+
+    static void* allocate(size_t bytes) {
+        if (bytes < PAGE) return ::operator new(bytes);
+        size_t rounded = (bytes + PAGE - 1) / PAGE * PAGE;
+        metrics.liveBytes += rounded;
+        int mode = currentMode();
+        if (mode == HUGE_PAGES_EXPLICIT) {
+            void* p = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (p != MAP_FAILED) {
+                metrics.explicitBytes += rounded;
+                return p;
+            }
+            metrics.explicitFallbacks++;
+        }
+        if (mode == HUGE_PAGES_OFF) {
+            void* p = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) throw std::bad_alloc();
+            metrics.plainBytes += rounded;
+            return p;
+        }
+        // Over-map by one page and trim, so the block starts on a 2 MB boundary
+        char* raw = (char*)mmap(nullptr, rounded + PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) throw std::bad_alloc();
+        char* aligned = (char*)(((uintptr_t)raw + PAGE - 1) & ~(uintptr_t)(PAGE - 1));
+        if (aligned > raw) munmap(raw, aligned - raw);
+        if (aligned + rounded < raw + rounded + PAGE) munmap(aligned + rounded, raw + rounded + PAGE - (aligned + rounded));
+        madvise(aligned, rounded, MADV_HUGEPAGE);
+        metrics.advisedBytes += rounded;
+        return aligned;
+    }
+
+    static void release(void* p, size_t bytes) {
+        if (bytes < PAGE) {
+            ::operator delete(p);
+            return;
+        }
+        size_t rounded = (bytes + PAGE - 1) / PAGE * PAGE;
+        munmap(p, rounded);
+        metrics.liveBytes -= rounded;
+    }
+};
+
+// The arena allocates in the given mode on this thread while the scope lasts,
+// so library objects with different hugePages settings can run side by side
+class HugePageScope {
+private:
+    int previous;
+
+public:
+    explicit HugePageScope(int mode) : previous(HugePageArena::scopedMode) { HugePageArena::scopedMode = mode; }
+    ~HugePageScope() { HugePageArena::scopedMode = previous; }
+
+    HugePageScope(const HugePageScope&) = delete;
+    HugePageScope& operator=(const HugePageScope&) = delete;
+};
+
+// Function to look up a hugePages setting; returns -1 if unknown
+inline int hugePageMode(const std::string& name) {
+    if (name == "off") return HUGE_PAGES_OFF;
+    if (name == "transparent") return HUGE_PAGES_TRANSPARENT;
+    if (name == "explicit") return HUGE_PAGES_EXPLICIT;
+    return -1;
+}
+
+// Anonymous memory of the process backed by transparent huge pages, in MB
+inline double anonHugePagesMb() {
+    std::ifstream rollup("/proc/self/smaps_rollup");
+    std::string line;
+    while (std::getline(rollup, line)) {
+        if (line.compare(0, 14, "AnonHugePages:") == 0) return std::stod(line.substr(14)) / 1024;
+    }
+    return 0;
+}
+
+// Allocator for containers kept in the huge-page arena
+template <typename T>
+struct HugePageAllocator {
+    typedef T value_type;
+
+    HugePageAllocator() = default;
+    template <typename U>
+    HugePageAllocator(const HugePageAllocator<U>&) {}
+
+    T* allocate(size_t n) { return (T*)HugePageArena::allocate(n * sizeof(T)); }
+    void deallocate(T* p, size_t n) { HugePageArena::release(p, n * sizeof(T)); }
+
+    template <typename U>
+    bool operator==(const HugePageAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const HugePageAllocator<U>&) const { return false; }
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, HugePageAllocator<T>>;
+
+// Future event list of the discrete-event mode. E needs SimTime time and
+// unsigned long long seq (tie-breaker among equal times) members; events are
+// popped in (time, seq) order and never pushed earlier than the last pop.
+template <typename E>
+class FutureEventList {
+public:
+    virtual ~FutureEventList() {}
+    virtual void push(const E& e) = 0;
+    virtual const E& top() = 0;
+    virtual void pop() = 0;
+    virtual bool empty() const = 0;
+    virtual size_t size() const = 0;
+    virtual void clear() = 0; // empty again, keeping the storage for the next run
+    virtual std::unique_ptr<FutureEventList<E>> clone() const = 0;
+
+    // Replaces the contents with the given events, none earlier than base,
+    // keeping the storage
+    virtual void reload(const std::vector<E>& events, SimTime base) {
+        (void)base;
+        clear();
+        for (const E& e : events) push(e);
+    }
+};
+
+template <typename E>
+bool eventBefore(const E& a, const E& b) {
+    if (a.time == b.time) return a.seq < b.seq;
+    return a.time < b.time;
+}
+
+template <typename E>
+struct LaterEvent {
+    bool operator()(const E& a, const E& b) const { return eventBefore(b, a); }
+};
+
+// Binary heap of events that can be emptied without freeing its array
+template <typename E>
+struct EventHeap : std::priority_queue<E, ArenaVector<E>, LaterEvent<E>> {
+    void clear() { this->c.clear(); }
+};
+
+// Plain binary heap
+template <typename E>
+class BinaryHeapQueue final : public FutureEventList<E> {
+private:
+    EventHeap<E> heap;
+
+public:
+    void push(const E& e) override { heap.push(e); }
+    const E& top() override { return heap.top(); }
+    void pop() override { heap.pop(); }
+    bool empty() const override { return heap.empty(); }
+    size_t size() const override { return heap.size(); }
+    void clear() override { heap.clear(); }
+    std::unique_ptr<FutureEventList<E>> clone() const override { return std::unique_ptr<FutureEventList<E>>(new BinaryHeapQueue(*this)); }
+};
+
+// Binary heap for events due within the current hour; later ones (ward stays,
+// return visits days ahead) are parked in a calendar of hour-wide buckets and
+// moved into the heap when the clock reaches their hour, so the heap stays
+// small on long horizons.
+template <typename E>
+class TieredHeapQueue final : public FutureEventList<E> {
+private:
+    static const SimTime BUCKET_WIDTH = 60 * 60 * TICKS_PER_SECOND;
+    static const int BUCKETS = 256; // one calendar "year" is 256 hours
+
+    EventHeap<E> near;
+    std::vector<ArenaVector<E>> calendar;
+    size_t farCount = 0;
+    SimTime nearLimit = BUCKET_WIDTH; // events before this time are in the heap
+
+    // Moves the next non-empty hour of the calendar into the heap
+    void advance() {
+        int emptyBuckets = 0;
+        while (near.empty() && farCount > 0) {
+            if (emptyBuckets == BUCKETS) {
+                // A whole year without events: jump straight to the earliest one
+                SimTime earliest = std::numeric_limits<SimTime>::max();
+                for (auto& bucket : calendar) {
+                    for (auto& e : bucket) earliest = std::min(earliest, e.time);
+                }
+                nearLimit = (earliest / BUCKET_WIDTH) * BUCKET_WIDTH;
+                emptyBuckets = 0;
+            }
+            ArenaVector<E>& bucket = calendar[(nearLimit / BUCKET_WIDTH) % BUCKETS];
+            nearLimit += BUCKET_WIDTH;
+            size_t kept = 0;
+            for (size_t i = 0; i < bucket.size(); ++i) {
+                if (bucket[i].time < nearLimit) {
+                    near.push(bucket[i]);
+                } else {
+                    bucket[kept++] = bucket[i]; // due in a later calendar year
+                }
+            }
+            farCount -= bucket.size() - kept;
+            bucket.resize(kept);
+            if (near.empty()) ++emptyBuckets;
+        }
+    }
+
+public:
+    TieredHeapQueue() : calendar(BUCKETS) {}
+
+    void push(const E& e) override {
+        if (e.time < nearLimit) {
+            near.push(e);
+        } else {
+            calendar[(e.time / BUCKET_WIDTH) % BUCKETS].push_back(e);
+            ++farCount;
+        }
+    }
+
+    const E& top() override {
+        if (near.empty()) advance();
+        return near.top();
+    }
+
+    void pop() override {
+        if (near.empty()) advance();
+        near.pop();
+    }
+
+    bool empty() const override { return near.empty() && farCount == 0; }
+    size_t size() const override { return near.size() + farCount; }
+
+    void clear() override {
+        near.clear();
+        for (auto& bucket : calendar) bucket.clear();
+        farCount = 0;
+        nearLimit = BUCKET_WIDTH;
+    }
+
+    std::unique_ptr<FutureEventList<E>> clone() const override { return std::unique_ptr<FutureEventList<E>>(new TieredHeapQueue(*this)); }
+};
+
+// Pairing heap with nodes in a recycled pool: O(1) insert, amortized
+// O(log n) extract-min
+template <typename E>
+class PairingHeapQueue final : public FutureEventList<E> {
+private:
+    struct Node {
+        E event;
+        int child;
+        int sibling;
+    };
+
+    ArenaVector<Node> nodes;
+    std::vector<int> freeNodes;
+    std::vector<int> pairs; // scratch for the two-pass merge
+    int root = -1;
+    size_t count = 0;
+
+    int meld(int a, int b) {
+        if (a < 0) return b;
+        if (b < 0) return a;
+        if (eventBefore(nodes[b].event, nodes[a].event)) std::swap(a, b);
+        nodes[b].sibling = nodes[a].child;
+        nodes[a].child = b;
+        return a;
+    }
+
+public:
+    void push(const E& e) override {
+        int node;
+        if (!freeNodes.empty()) {
+            node = freeNodes.back();
+            freeNodes.pop_back();
+            nodes[node] = {e, -1, -1};
+        } else {
+            node = (int)nodes.size();
+            nodes.push_back({e, -1, -1});
+        }
+        root = meld(root, node);
+        ++count;
+    }
+
+    const E& top() override { return nodes[root].event; }
+
+    void pop() override {
+        int old = root;
+        // First pass: meld children pairwise left to right
+        pairs.clear();
+        int child = nodes[old].child;
+        while (child >= 0) {
+            int second = nodes[child].sibling;
+            int next = second >= 0 ? nodes[second].sibling : -1;
+            nodes[child].sibling = -1;
+            if (second >= 0) nodes[second].sibling = -1;
+            pairs.push_back(meld(child, second));
+            child = next;
+        }
+        // Second pass: meld the pairs right to left
+        root = -1;
+        for (size_t i = pairs.size(); i-- > 0;) root = meld(pairs[i], root);
+        freeNodes.push_back(old);
+        --count;
+    }
+
+    bool empty() const override { return count == 0; }
+    size_t size() const override { return count; }
+
+    void clear() override {
+        nodes.clear();
+        freeNodes.clear();
+        root = -1;
+        count = 0;
+    }
+
+    std::unique_ptr<FutureEventList<E>> clone() const override { return std::unique_ptr<FutureEventList<E>>(new PairingHeapQueue(*this)); }
+};
+
+// Calendar queue (R. Brown, 1988): an array of buckets, each covering one
+// "day" of `width` ticks in a repeating "year". Insert and extract-min are
+// amortized O(1) while the bucket width matches the event spacing. The number
+// of buckets doubles or halves with the queue size, and the width is
+// re-estimated at each resize from the spacing of the earlier half of the
+// pending events. Brown's sample of the first few events breaks down when
+// many events share a time stamp. A queue whose size stays constant would
+// never resize, so it is also recalibrated when the measured work per
+// operation shows the width has drifted away from the event spacing.
+template <typename E>
+class CalendarQueue final : public FutureEventList<E> {
+private:
+    static const size_t MIN_BUCKETS = 2;
+    static const long long WORK_PER_OP_LIMIT = 8;
+
+    // Events of one day, sorted ascending from `head`; popping advances head.
+    // New events usually sort last among equal times (larger seq), so keeping
+    // the order ascending makes inserting into a cluster of ties cheap.
+    struct Bucket {
+        ArenaVector<E> items;
+        size_t head = 0;
+
+        bool empty() const { return head == items.size(); }
+        const E& front() const { return items[head]; }
+    };
+
+    std::vector<Bucket> buckets;
+    size_t count = 0;
+    SimTime width = TICKS_PER_SECOND;
+    size_t current = 0;        // bucket of the last dequeued event
+    SimTime bucketTop = TICKS_PER_SECOND; // end of that event's day
+    SimTime lastTime = 0;
+    long long cachedMin = -1;  // bucket holding the minimum, -1 if unknown
+    long long ops = 0;         // operations since the last resize
+    long long work = 0;        // buckets scanned and events shifted since then
+    long long resizes = 0;
+    std::vector<E> scratch;
+
+    size_t bucketOf(SimTime time) const {
+        return (size_t)((time / width) % (SimTime)buckets.size());
+    }
+
+    void insert(const E& e) {
+        Bucket& bucket = buckets[bucketOf(e.time)];
+        if (bucket.head > 0 && bucket.head == bucket.items.size()) {
+            bucket.items.clear();
+            bucket.head = 0;
+        }
+        // Buckets are short; insertion from the back keeps them sorted
+        ArenaVector<E>& items = bucket.items;
+        items.push_back(e);
+        size_t i = items.size() - 1;
+        while (i > bucket.head && eventBefore(e, items[i - 1])) {
+            items[i] = items[i - 1];
+            --i;
+            ++work;
+        }
+        items[i] = e;
+    }
+
+    // Scans forward from the day of the last dequeued event. The scan position
+    // is only committed by pop(), so pushes between top() and pop() that land
+    // before the minimum are still found.
+    size_t locateMin() {
+        if (cachedMin >= 0) return (size_t)cachedMin;
+        size_t n = buckets.size();
+        size_t i = current;
+        SimTime top = bucketTop;
+        for (size_t k = 0; k < n; ++k) {
+            if (!buckets[i].empty() && buckets[i].front().time < top) {
+                work += k;
+                cachedMin = (long long)i;
+                return i;
+            }
+            i = (i + 1) == n ? 0 : i + 1;
+            top += width;
+        }
+        // Nothing due within a whole year: direct search over the bucket heads
+        work += 2 * n;
+        size_t best = n;
+        for (size_t j = 0; j < n; ++j) {
+            if (!buckets[j].empty() && (best == n || eventBefore(buckets[j].front(), buckets[best].front()))) best = j;
+        }
+        cachedMin = (long long)best;
+        return best;
+    }
+
+    // Three times the mean spacing of the earlier half of the events in scratch
+    SimTime estimateWidth() {
+        if (scratch.size() < 2) return width;
+        size_t half = scratch.size() / 2;
+        std::nth_element(scratch.begin(), scratch.begin() + half, scratch.end(), eventBefore<E>);
+        SimTime head = scratch[0].time;
+        for (size_t i = 1; i < half; ++i) head = std::min(head, scratch[i].time);
+        double spacing = (double)(scratch[half].time - head) / half;
+        if (spacing <= 0) {
+            // The earlier half shares one time stamp: use the whole queue
+            SimTime tail = head;
+            for (const E& e : scratch) tail = std::max(tail, e.time);
+            spacing = (double)(tail - head) / scratch.size();
+        }
+        return spacing > 0 ? std::max((SimTime)(3 * spacing), (SimTime)1) : width;
+    }
+
+    void resize(size_t newBuckets) {
+        scratch.clear();
+        for (Bucket& bucket : buckets) {
+            scratch.insert(scratch.end(), bucket.items.begin() + bucket.head, bucket.items.end());
+            bucket.items.clear();
+            bucket.head = 0;
+        }
+        redistribute(newBuckets);
+    }
+
+    // Spreads the events in scratch over newBuckets empty buckets of a width
+    // estimated from them
+    void redistribute(size_t newBuckets) {
+        width = estimateWidth();
+        buckets.resize(newBuckets);
+        for (const E& e : scratch) insert(e);
+        current = bucketOf(lastTime);
+        bucketTop = (lastTime / width + 1) * width;
+        cachedMin = -1;
+        ops = 0;
+        work = 0;
+        ++resizes;
+    }
+
+    // A queue only shrinks after a pass over its buckets' worth of operations,
+    // so one that is refilled after clear() keeps its buckets
+    void checkBalance() {
+        ++ops;
+        size_t n = buckets.size();
+        if (count > 2 * n) {
+            resize(2 * n);
+        } else if (n > MIN_BUCKETS && count < n / 2 && ops >= (long long)n) {
+            resize(n / 2);
+        } else if (ops >= (long long)n && work > WORK_PER_OP_LIMIT * ops) {
+            resize(n);
+        }
+    }
+
+public:
+    CalendarQueue() : buckets(MIN_BUCKETS) {}
+
+    void push(const E& e) override {
+        insert(e);
+        ++count;
+        // The new event may be earlier than the cached minimum
+        if (cachedMin >= 0 && eventBefore(e, buckets[cachedMin].front())) cachedMin = -1;
+        checkBalance();
+    }
+
+    const E& top() override {
+        return buckets[locateMin()].front();
+    }
+
+    void pop() override {
+        size_t i = locateMin();
+        Bucket& bucket = buckets[i];
+        lastTime = bucket.front().time;
+        if (++bucket.head == bucket.items.size()) {
+            bucket.items.clear();
+            bucket.head = 0;
+        }
+        --count;
+        current = i;
+        bucketTop = (lastTime / width + 1) * width;
+        cachedMin = -1;
+        checkBalance();
+    }
+
+    bool empty() const override { return count == 0; }
+    size_t size() const override { return count; }
+
+    // Keeps the buckets and their width, which suit the next run of the same
+    // model; the work check recalibrates the width if they do not
+    void clear() override {
+        for (Bucket& bucket : buckets) {
+            bucket.items.clear();
+            bucket.head = 0;
+        }
+        count = 0;
+        current = 0;
+        bucketTop = width;
+        lastTime = 0;
+        cachedMin = -1;
+        ops = work = resizes = 0;
+    }
+
+    // Keeps the bucket array unless the events no longer fit it, and
+    // recalibrates the width from the events
+    void reload(const std::vector<E>& events, SimTime base) override {
+        for (Bucket& bucket : buckets) {
+            bucket.items.clear();
+            bucket.head = 0;
+        }
+        size_t n = buckets.size();
+        while (events.size() > 2 * n) n *= 2;
+        while (n > MIN_BUCKETS && events.size() < n / 2) n /= 2;
+        scratch.assign(events.begin(), events.end());
+        count = events.size();
+        lastTime = base;
+        redistribute(n);
+    }
+
+    std::unique_ptr<FutureEventList<E>> clone() const override { return std::unique_ptr<FutureEventList<E>>(new CalendarQueue(*this)); }
+
+    size_t bucketCount() const { return buckets.size(); }
+    SimTime bucketWidth() const { return width; }
+    long long resizeCount() const { return resizes; }
+};
+
+// Radix heap over integer ticks. It relies on simulation time never going
+// backwards: an event is kept in the bucket of the highest bit in which its
+// time differs from the last extracted time, so each event moves down at most
+// 64 times over its life. Push is O(1) and extract-min is amortized O(log C)
+// for a time span C, with no comparisons between unrelated events.
+template <typename E>
+class RadixHeapQueue final : public FutureEventList<E> {
+private:
+    static const int BUCKETS = 65;
+
+    // Bucket 0 holds the events due exactly at `last`, in seq order from head
+    ArenaVector<E> buckets[BUCKETS];
+    size_t head = 0;
+    size_t count = 0;
+    SimTime last = 0;
+
+    static int bucketIndex(SimTime time, SimTime last) {
+        if (time == last) return 0;
+        return 64 - __builtin_clzll((unsigned long long)(time ^ last));
+    }
+
+    // Refills bucket 0 from the first non-empty bucket
+    void pull() {
+        buckets[0].clear();
+        head = 0;
+        int i = 1;
+        while (buckets[i].empty()) ++i;
+
+        ArenaVector<E>& source = buckets[i];
+        SimTime earliest = source[0].time;
+        for (const E& e : source) earliest = std::min(earliest, e.time);
+        last = earliest;
+        for (const E& e : source) buckets[bucketIndex(e.time, last)].push_back(e);
+        source.clear();
+
+        // Events sharing a time stamp all come from the same bucket; restore
+        // their FIFO order. Later pushes at this time have larger seqs.
+        std::sort(buckets[0].begin(), buckets[0].end(), eventBefore<E>);
+    }
+
+public:
+    void push(const E& e) override {
+        buckets[bucketIndex(e.time, last)].push_back(e);
+        ++count;
+    }
+
+    const E& top() override {
+        if (head == buckets[0].size()) pull();
+        return buckets[0][head];
+    }
+
+    void pop() override {
+        if (head == buckets[0].size()) pull();
+        ++head;
+        --count;
+    }
+
+    bool empty() const override { return count == 0; }
+    size_t size() const override { return count; }
+
+    void clear() override {
+        for (auto& bucket : buckets) bucket.clear();
+        head = 0;
+        count = 0;
+        last = 0;
+    }
+
+    // The base replaces the last extracted time that pushes are measured from
+    void reload(const std::vector<E>& events, SimTime base) override {
+        clear();
+        last = base;
+        for (const E& e : events) push(e);
+    }
+
+    std::unique_ptr<FutureEventList<E>> clone() const override { return std::unique_ptr<FutureEventList<E>>(new RadixHeapQueue(*this)); }
+};
+
+// Function to create a future event list by name; returns nullptr if unknown
+template <typename E>
+std::unique_ptr<FutureEventList<E>> makeFutureEventList(const std::string& kind) {
+    if (kind == "calendar") return std::unique_ptr<FutureEventList<E>>(new CalendarQueue<E>());
+    if (kind == "heap") return std::unique_ptr<FutureEventList<E>>(new BinaryHeapQueue<E>());
+    if (kind == "tiered") return std::unique_ptr<FutureEventList<E>>(new TieredHeapQueue<E>());
+    if (kind == "pairing") return std::unique_ptr<FutureEventList<E>>(new PairingHeapQueue<E>());
+    if (kind == "radix") return std::unique_ptr<FutureEventList<E>>(new RadixHeapQueue<E>());
+    return nullptr;
+}
+
+// Handle of a cancellable event: timer slot in the low 32 bits, the slot's
+// generation in the high 32 bits
+typedef long long TimerHandle;
+const TimerHandle NO_TIMER = -1;
+
+// Lazy cancellation on top of any future event list. A cancellable event
+// carries a timer slot and that slot's generation at scheduling time (E needs
+// int timer and unsigned int generation members, timer -1 for plain events).
+// Cancelling bumps the generation, which turns the queued entry into a
+// tombstone that is dropped when it reaches the top, so cancel is O(1) with
+// no index maintenance inside the queue. Once tombstones exceed half of the
+// queue it is compacted: the live events are reloaded into the same backend.
+template <typename E>
+class CancellableEventList {
+public:
+    struct Metrics {
+        long long pops = 0;
+        long long wastedPops = 0;          // tombstones reaching the top
+        long long cancellations = 0;
+        long long compactions = 0;
+        long long compactedTombstones = 0; // tombstones dropped by compaction
+    };
+
+private:
+    static const size_t MIN_COMPACTION_SIZE = 1024;
+
+    std::unique_ptr<FutureEventList<E>> queue;
+    ArenaVector<unsigned int> generations;
+    std::vector<int> freeTimers;
+    size_t tombstones = 0;
+    SimTime lastPop = 0; // no event is pushed earlier than this
+    Metrics metrics;
+    std::vector<E> scratch;
+
+    bool isTombstone(const E& e) const {
+        return e.timer >= 0 && generations[e.timer] != e.generation;
+    }
+
+    void releaseTimer(int timer) {
+        ++generations[timer];
+        freeTimers.push_back(timer);
+    }
+
+    void skipTombstones() {
+        while (tombstones > 0 && !queue->empty() && isTombstone(queue->top())) {
+            queue->pop();
+            --tombstones;
+            ++metrics.wastedPops;
+        }
+    }
+
+    void compact() {
+        scratch.clear();
+        while (!queue->empty()) {
+            if (!isTombstone(queue->top())) scratch.push_back(queue->top());
+            queue->pop();
+        }
+        queue->reload(scratch, lastPop);
+        metrics.compactedTombstones += tombstones;
+        metrics.compactions++;
+        tombstones = 0;
+    }
+
+public:
+    explicit CancellableEventList(const std::string& backend) : queue(makeFutureEventList<E>(backend)) {}
+
+    // A copy holds the same pending events and timers in its own backend
+    CancellableEventList(const CancellableEventList& other)
+        : queue(other.queue->clone()), generations(other.generations), freeTimers(other.freeTimers),
+          tombstones(other.tombstones), lastPop(other.lastPop), metrics(other.metrics) {}
+    CancellableEventList(CancellableEventList&&) = default;
+    CancellableEventList& operator=(CancellableEventList&&) = default;
+
+    void push(const E& e) {
+        queue->push(e);
+    }
+
+    TimerHandle pushCancellable(E e) {
+        int timer;
+        if (!freeTimers.empty()) {
+            timer = freeTimers.back();
+            freeTimers.pop_back();
+        } else {
+            timer = (int)generations.size();
+            generations.push_back(0);
+        }
+        e.timer = timer;
+        e.generation = generations[timer];
+        queue->push(e);
+        return ((TimerHandle)e.generation << 32) | (unsigned int)timer;
+    }
+
+    // Returns false if the event already fired or was cancelled
+    bool cancel(TimerHandle handle) {
+        if (handle == NO_TIMER) return false;
+        int timer = (int)(handle & 0xffffffff);
+        if (generations[timer] != (unsigned int)(handle >> 32)) return false;
+        releaseTimer(timer);
+        ++tombstones;
+        metrics.cancellations++;
+        if (queue->size() >= MIN_COMPACTION_SIZE && tombstones * 2 > queue->size()) compact();
+        return true;
+    }
+
+    bool empty() {
+        skipTombstones();
+        return queue->empty();
+    }
+
+    const E& top() {
+        skipTombstones();
+        return queue->top();
+    }
+
+    void pop() {
+        skipTombstones();
+        const E& e = queue->top();
+        if (e.timer >= 0) releaseTimer(e.timer);
+        lastPop = e.time;
+        queue->pop();
+        metrics.pops++;
+    }
+
+    // Drops every event and timer; handles from before are no longer valid
+    void clear() {
+        queue->clear();
+        generations.clear();
+        freeTimers.clear();
+        tombstones = 0;
+        lastPop = 0;
+        metrics = Metrics();
+    }
+
+    size_t size() const { return queue->size() - tombstones; }
+    size_t tombstoneCount() const { return tombstones; }
+    const Metrics& statistics() const { return metrics; }
+};
+
+// Time-weighted average of an integer level (queue length, occupied beds, ...)
+struct TimeWeighted {
+    double area = 0;
+    SimTime last = 0;
+    int value = 0;
+
+    void set(SimTime now, int newValue) {
+        area += (double)value * (now - last);
+        last = now;
+        value = newValue;
+    }
+
+    double mean(SimTime now) const {
+        if (now <= 0) return value;
+        return (area + (double)value * (now - last)) / now;
+    }
+};
+
+// Patient pathway of the discrete-event engine: a transition table from
+// (state, event) to the next state and the action to run. The default table
+// below reproduces the built-in flow; "transition" lines in a scenario replace
+// single entries. The table is checked and compiled once into a flat array, so
+// handling a patient event is one indexed load and a switch.
+enum PatientState { WAITING, IN_TREATMENT, WAITING_VENTILATOR, BOARDING, IN_WARD, DISCHARGED, LEFT, PATIENT_STATES };
+enum PatientEvent {
+    TEAM_ASSIGNED, NO_VENTILATOR, VENTILATOR_FREE, TREATED, ADMITTED, NO_BED, BED_ASSIGNED, WARD_DONE,
+    WORSENED, PATIENCE_OUT, BOARDING_FULL, PATIENT_EVENTS
+};
+enum PathwayAction {
+    NO_ACTION, TREAT, TREAT_WITHOUT_VENTILATOR, WAIT_FOR_VENTILATOR, DISCHARGE, WARD_STAY, BOARD, TRANSFER,
+    BOARDER_TO_WARD, LEAVE_WARD, ESCALATE, LEAVE, PATHWAY_ACTIONS
+};
+
+const char* const PATIENT_STATE_NAMES[PATIENT_STATES] = {
+    "Waiting", "InTreatment", "WaitingVentilator", "Boarding", "InWard", "Discharged", "Left"
+};
+const char* const PATIENT_EVENT_NAMES[PATIENT_EVENTS] = {
+    "TeamAssigned", "NoVentilator", "VentilatorFree", "Treated", "Admitted", "NoBed", "BedAssigned", "WardDone",
+    "Worsened", "PatienceOut", "BoardingFull"
+};
+
+// Each action can answer one event and leads to one state (-1: stays put)
+struct PathwayActionInfo {
+    const char* name;
+    PatientEvent event;
+    int target;
+};
+const PathwayActionInfo PATHWAY_ACTIONS_INFO[PATHWAY_ACTIONS] = {
+    {"none", PATIENT_EVENTS, -1},
+    {"treat", PATIENT_EVENTS, IN_TREATMENT},  // answers TeamAssigned and VentilatorFree
+    {"treatWithoutVentilator", NO_VENTILATOR, IN_TREATMENT},
+    {"waitForVentilator", NO_VENTILATOR, WAITING_VENTILATOR},
+    {"discharge", TREATED, DISCHARGED},
+    {"wardStay", ADMITTED, IN_WARD},
+    {"board", NO_BED, BOARDING},
+    {"transfer", PATIENT_EVENTS, DISCHARGED},  // answers Admitted, NoBed and BoardingFull
+    {"boarderToWard", BED_ASSIGNED, IN_WARD},
+    {"leaveWard", WARD_DONE, DISCHARGED},
+    {"escalate", WORSENED, WAITING},
+    {"leave", PATIENCE_OUT, LEFT},
+};
+
+const char* const DEFAULT_PATHWAY[] = {
+    "Waiting, TeamAssigned -> InTreatment : treat",
+    "Waiting, Worsened -> Waiting : escalate",
+    "Waiting, PatienceOut -> Left : leave",
+    "InTreatment, NoVentilator -> InTreatment : treatWithoutVentilator",
+    "WaitingVentilator, VentilatorFree -> InTreatment : treat",
+    "InTreatment, Treated -> Discharged : discharge",
+    "InTreatment, Admitted -> InWard : wardStay",
+    "InTreatment, NoBed -> Boarding : board",
+    "InTreatment, BoardingFull -> Discharged : transfer",
+    "Boarding, BedAssigned -> InWard : boarderToWard",
+    "InWard, WardDone -> Discharged : leaveWard",
+};
+
+class PatientPathway {
+public:
+    struct Transition {
+        PatientState next;
+        PathwayAction action;
+        bool defined;
+    };
+
+private:
+    Transition table[PATIENT_STATES * PATIENT_EVENTS];
+
+    template <size_t N>
+    static int lookup(const char* const (&names)[N], const std::string& name) {
+        for (size_t i = 0; i < N; ++i) {
+            if (name == names[i]) return (int)i;
+        }
+        return -1;
+    }
+
+    static bool actionAnswers(PathwayAction action, PatientEvent event) {
+        if (action == NO_ACTION) return event == WORSENED || event == PATIENCE_OUT;
+        if (action == TREAT) return event == TEAM_ASSIGNED || event == VENTILATOR_FREE;
+        if (action == TRANSFER) return event == ADMITTED || event == NO_BED || event == BOARDING_FULL;
+        return PATHWAY_ACTIONS_INFO[action].event == event;
+    }
+
+    // Parses "State, Event -> State : action" into the table
+    bool addRule(const std::string& rule, std::string& error) {
+        std::string text;
+        for (char c : rule) {
+            text += (c == ',' || c == ':' || c == '-' || c == '>') ? ' ' : c;
+        }
+        std::istringstream in(text);
+        std::string from, event, to, action, extra;
+        if (!(in >> from >> event >> to >> action) || (in >> extra) || rule.find("->") == std::string::npos ||
+            rule.find(':') == std::string::npos) {
+            error = "expected \"State, Event -> State : action\" in \"" + rule + "\"";
+            return false;
+        }
+        int s = lookup(PATIENT_STATE_NAMES, from), e = lookup(PATIENT_EVENT_NAMES, event);
+        int t = lookup(PATIENT_STATE_NAMES, to);
+        int a = -1;
+        for (int i = 0; i < PATHWAY_ACTIONS; ++i) {
+            if (action == PATHWAY_ACTIONS_INFO[i].name) a = i;
+        }
+        if (s < 0 || t < 0) {
+            error = "unknown state in \"" + rule + "\"";
+            return false;
+        }
+        if (e < 0 || a < 0) {
+            error = "unknown " + std::string(e < 0 ? "event " + event : "action " + action) + " in \"" + rule + "\"";
+            return false;
+        }
+        if (!actionAnswers(PathwayAction(a), PatientEvent(e))) {
+            error = "action " + action + " cannot handle " + event;
+            return false;
+        }
+        int target = PATHWAY_ACTIONS_INFO[a].target < 0 ? s : PATHWAY_ACTIONS_INFO[a].target;
+        if (t != target) {
+            error = "action " + action + " leads to " + PATIENT_STATE_NAMES[target] + ", not " + to;
+            return false;
+        }
+        table[s * PATIENT_EVENTS + e] = {PatientState(t), PathwayAction(a), true};
+        return true;
+    }
+
+public:
+    // Builds the table from the defaults and the overrides; checks that every
+    // state a patient can reach handles the events the engine raises there
+    bool compile(const std::vector<std::string>& overrides, std::string& error) {
+        for (Transition& t : table) t = {WAITING, NO_ACTION, false};
+        for (const char* rule : DEFAULT_PATHWAY) {
+            if (!addRule(rule, error)) return false;
+        }
+        for (const std::string& rule : overrides) {
+            if (!addRule(rule, error)) return false;
+        }
+
+        const std::vector<PatientEvent> required[PATIENT_STATES] = {
+            {TEAM_ASSIGNED}, {NO_VENTILATOR, TREATED, ADMITTED, NO_BED, BOARDING_FULL}, {VENTILATOR_FREE}, {BED_ASSIGNED},
+            {WARD_DONE}, {}, {}
+        };
+        bool reachable[PATIENT_STATES] = {true};
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (int s = 0; s < PATIENT_STATES; ++s) {
+                if (!reachable[s]) continue;
+                for (int e = 0; e < PATIENT_EVENTS; ++e) {
+                    const Transition& t = table[s * PATIENT_EVENTS + e];
+                    if (t.defined && !reachable[t.next]) changed = reachable[t.next] = true;
+                }
+            }
+        }
+        for (int s = 0; s < PATIENT_STATES; ++s) {
+            if (!reachable[s]) continue;
+            for (PatientEvent e : required[s]) {
+                if (!table[s * PATIENT_EVENTS + e].defined) {
+                    error = std::string("no transition for ") + PATIENT_EVENT_NAMES[e] + " in state " + PATIENT_STATE_NAMES[s];
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    const Transition& at(PatientState state, PatientEvent event) const {
+        return table[state * PATIENT_EVENTS + event];
+    }
+};
+
+// Discrete-event version of the model. It keeps the same resources and rules as
+// the threaded mode but runs in virtual time, so horizons of weeks (ward stays
+// measured in days) finish in seconds of CPU time.
+class DiscreteEventSimulation {
+public:
+    enum EventType {
+        ARRIVAL, TREATMENT_END, WARD_DISCHARGE, RESOURCE_GENERATION, BREAK_START, BREAK_END,
+        UNIT_FAILURE, UNIT_BACK_IN_SERVICE, MAINTENANCE_START, DETERIORATION, RETURN_VISIT, ABANDONMENT
+    };
+    enum EquipmentKind { VENTILATOR, EXAM_ROOM };
+
+    struct Event {
+        SimTime time;
+        unsigned long long seq; // FIFO among events at the same time
+        EventType type;
+        int subject;            // patient slot or equipment unit, -1 if none
+        int timer = -1;         // timer slot of a cancellable event
+        unsigned int generation = 0;
+    };
+
+    struct Stats {
+        long long arrived[PRIORITY_LEVELS] = {};
+        long long treated[PRIORITY_LEVELS] = {};
+        long long admitted[PRIORITY_LEVELS] = {};
+        long long deteriorated[PRIORITY_LEVELS] = {};  // patients, by triage priority
+        long long deterioratedTreated = 0;
+        double deterioratedWaitSeconds = 0;
+        long long escalations = 0;
+        long long abandoned[PRIORITY_LEVELS] = {};    // left without being seen, by triage priority
+        double abandonWaitSeconds = 0;
+        long long returnVisits[PRIORITY_LEVELS] = {};  // arrivals that are return visits
+        long long returnsScheduled = 0;
+        double waitSeconds[PRIORITY_LEVELS] = {};
+        double maxWaitSeconds[PRIORITY_LEVELS] = {};
+        std::vector<float> waitSamples[PRIORITY_LEVELS];    // each wait, for distribution checks
+        double treatmentSeconds = 0;                   // treatment time inside the horizon
+        long long boarded = 0;
+        double boardingSeconds = 0;
+        double maxBoardingSeconds = 0;
+        long long wardDischarges = 0;
+        long long transfers = 0;                       // admitted patients sent to another hospital
+        long long boardingFullTransfers = 0;           // of those, sent because maxBoarders were boarding
+        long long ventilatorShortages = 0;
+        long long ventilatorShortagesDuringOutage = 0;
+        long long failures[2] = {};
+        long long maintenanceWindows[2] = {};
+        TimeWeighted unitsInService[2];
+        long long eventsProcessed = 0;
+        TimeWeighted queueLength;
+        TimeWeighted wardOccupancy;
+        TimeWeighted edBoarders;
+        TimeWeighted gridlock;                         // 1 while boarders hold every exam room
+
+        // Zeroes everything; the wait samples keep their capacity
+        void reset() {
+            std::vector<float> samples[PRIORITY_LEVELS];
+            for (int p = 0; p < PRIORITY_LEVELS; ++p) samples[p].swap(waitSamples[p]);
+            *this = Stats();
+            for (int p = 0; p < PRIORITY_LEVELS; ++p) {
+                samples[p].clear();
+                waitSamples[p].swap(samples[p]);
+            }
+        }
+    };
+
+private:
+    // Patients are entities: a slot number indexing dense component arrays.
+    // Each handler reads and writes only the components it needs, so adding an
+    // attribute does not widen what the other handlers walk through. Slots are
+    // recycled through a free list, so long runs only keep the patients
+    // currently in the system. The arrays live in the huge-page arena.
+    struct PatientComponents {
+        // Identity and acuity
+        ArenaVector<int> id;
+        ArenaVector<Priority> triage;        // priority at arrival, used for the per-priority stats
+        ArenaVector<Priority> priority;      // current priority
+        ArenaVector<PatientState> state;
+        // Timestamps
+        ArenaVector<SimTime> arrival;
+        ArenaVector<SimTime> boardingStart;
+        ArenaVector<double> waitSeconds;
+        // Pending timers and assigned resources
+        ArenaVector<TimerHandle> deteriorationTimer;
+        ArenaVector<TimerHandle> abandonTimer;
+        ArenaVector<unsigned char> ventilator;
+        ArenaVector<int> freeSlots;
+
+        int create(int patientId, Priority acuity, SimTime now) {
+            int slot;
+            if (!freeSlots.empty()) {
+                slot = freeSlots.back();
+                freeSlots.pop_back();
+            } else {
+                slot = (int)id.size();
+                id.push_back(0);
+                triage.push_back(acuity);
+                priority.push_back(acuity);
+                state.push_back(DISCHARGED);
+                arrival.push_back(0);
+                boardingStart.push_back(0);
+                waitSeconds.push_back(0);
+                deteriorationTimer.push_back(NO_TIMER);
+                abandonTimer.push_back(NO_TIMER);
+                ventilator.push_back(0);
+            }
+            id[slot] = patientId;
+            triage[slot] = priority[slot] = acuity;
+            state[slot] = WAITING;
+            arrival[slot] = now;
+            boardingStart[slot] = 0;
+            waitSeconds[slot] = 0;
+            deteriorationTimer[slot] = abandonTimer[slot] = NO_TIMER;
+            ventilator[slot] = 0;
+            return slot;
+        }
+
+        void destroy(int slot) {
+            freeSlots.push_back(slot);
+        }
+
+        void clear() {
+            id.clear();
+            triage.clear();
+            priority.clear();
+            state.clear();
+            arrival.clear();
+            boardingStart.clear();
+            waitSeconds.clear();
+            deteriorationTimer.clear();
+            abandonTimer.clear();
+            ventilator.clear();
+            freeSlots.clear();
+        }
+    };
+
+    enum UnitState { UNIT_UP, UNIT_FAILED, UNIT_MAINTENANCE };
+
+    // Ventilators and exam rooms, each with its own failure and maintenance
+    // process, stored the same way
+    struct UnitComponents {
+        std::vector<EquipmentKind> kind;
+        std::vector<UnitState> state;
+        std::vector<unsigned char> failureScheduled;
+
+        int create(EquipmentKind unitKind) {
+            kind.push_back(unitKind);
+            state.push_back(UNIT_UP);
+            failureScheduled.push_back(0);
+            return (int)kind.size() - 1;
+        }
+
+        void clear() {
+            kind.clear();
+            state.clear();
+            failureScheduled.clear();
+        }
+    };
+
+    const SimConfig& cfg;
+    std::mt19937 rng;
+    SimTime now = 0;
+    SimTime horizon = 0;
+    unsigned long long nextSeq = 0;
+    CancellableEventList<Event> events;
+    PatientQueue waiting; // handles are patient slots
+
+    PatientComponents patients;
+    int nextPatientId = 1;
+    PatientPathway pathway;
+    std::deque<int> ventilatorQueue; // HIGH patients holding a team until a ventilator is free
+
+    int doctorsFree = 0, nursesFree = 0, roomsFree = 0, ventilatorsFree = 0;
+    int roomsHeld = 0; // by patients in treatment or boarding; with roomsFree, the rooms in service
+    int idleDoctors = 0;
+    int wardOccupied = 0;
+    Ward ward;
+    Stats stats;
+
+    // Units are numbered ventilators first, then exam rooms. Capacity added by
+    // dynamic resource generation has no failure process.
+    UnitComponents units;
+    std::deque<int> pendingOutages[2]; // failed units still busy with a patient
+    int unitsUp[2] = {};
+
+    double uniform() {
+        return std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+    }
+
+    void schedule(SimTime time, EventType type, int subject = -1) {
+        events.push({time, nextSeq++, type, subject});
+    }
+
+    TimerHandle scheduleCancellable(SimTime time, EventType type, int subject) {
+        return events.pushCancellable({time, nextSeq++, type, subject});
+    }
+
+    void admitToQueue(Priority priority) {
+        int slot = patients.create(nextPatientId++, priority, now);
+        waiting.push(slot, patients.id[slot], priority);
+        scheduleDeterioration(slot);
+        scheduleAbandonment(slot);
+        stats.arrived[priority]++;
+        stats.queueLength.set(now, (int)waiting.size());
+        dispatch();
+    }
+
+    void handleArrival() {
+        int gap = std::uniform_int_distribution<int>(cfg.arrivalMinSeconds, cfg.arrivalMaxSeconds)(rng);
+        schedule(now + gap * TICKS_PER_SECOND, ARRIVAL);
+        admitToQueue(Priority(std::uniform_int_distribution<int>(0, PRIORITY_LEVELS - 1)(rng)));
+    }
+
+    // A return visit comes back with the triage priority of the first visit
+    void handleReturnVisit(Priority priority) {
+        stats.returnVisits[priority]++;
+        admitToQueue(priority);
+    }
+
+    // Return visits are usually days ahead, so they land in the far-future tier
+    void scheduleReturnVisit(int slot) {
+        Priority triage = patients.triage[slot];
+        if (uniform() >= returnVisitProbability(cfg, triage, patients.waitSeconds[slot])) return;
+        std::exponential_distribution<double> delay(1.0 / (cfg.returnDelayMeanDays * TICKS_PER_DAY));
+        schedule(now + (SimTime)delay(rng) + 1, RETURN_VISIT, triage);
+        stats.returnsScheduled++;
+    }
+
+    // Starts treatments while a doctor thread and all resources are free
+    void dispatch() {
+        while (!waiting.empty() && idleDoctors > 0 && doctorsFree > 0 && nursesFree > 0 && roomsFree > 0) {
+            int slot = waiting.top().handle;
+            waiting.pop();
+            stats.queueLength.set(now, (int)waiting.size());
+            --idleDoctors;
+            --doctorsFree;
+            --nursesFree;
+            --roomsFree;
+            ++roomsHeld;
+
+            events.cancel(patients.deteriorationTimer[slot]);
+            events.cancel(patients.abandonTimer[slot]);
+            patients.deteriorationTimer[slot] = NO_TIMER;
+            patients.abandonTimer[slot] = NO_TIMER;
+
+            Priority triage = patients.triage[slot];
+            double wait = ticksToSeconds(now - patients.arrival[slot]);
+            patients.waitSeconds[slot] = wait;
+            stats.waitSeconds[triage] += wait;
+            stats.waitSamples[triage].push_back((float)wait);
+            stats.maxWaitSeconds[triage] = std::max(stats.maxWaitSeconds[triage], wait);
+            if (patients.priority[slot] != triage) {
+                stats.deterioratedTreated++;
+                stats.deterioratedWaitSeconds += wait;
+            }
+            fire(slot, TEAM_ASSIGNED);
+        }
+    }
+
+    // Runs the pathway transition of a patient event
+    void fire(int slot, PatientEvent event) {
+        const PatientPathway::Transition& transition = pathway.at(patients.state[slot], event);
+        if (!transition.defined) return; // Not part of this pathway
+        patients.state[slot] = transition.next;
+
+        switch (transition.action) {
+            case NO_ACTION: break;
+            case TREAT: startTreatment(slot); break;
+            case TREAT_WITHOUT_VENTILATOR:
+                countVentilatorShortage();
+                scheduleTreatmentEnd(slot);
+                break;
+            case WAIT_FOR_VENTILATOR:
+                countVentilatorShortage();
+                ventilatorQueue.push_back(slot);
+                break;
+            case DISCHARGE:
+                releaseRoom();
+                scheduleReturnVisit(slot);
+                patients.destroy(slot);
+                break;
+            case WARD_STAY:
+                ward.admit(slot);
+                releaseRoom();
+                startWardStay(slot);
+                break;
+            case BOARD:
+                // No bed: the patient boards in the ED and keeps the exam room
+                ward.admit(slot);
+                patients.boardingStart[slot] = now;
+                stats.boarded++;
+                stats.edBoarders.set(now, ward.boarding());
+                updateGridlock();
+                break;
+            case TRANSFER:
+                releaseRoom();
+                stats.transfers++;
+                patients.destroy(slot);
+                break;
+            case BOARDER_TO_WARD: {
+                double boarding = ticksToSeconds(now - patients.boardingStart[slot]);
+                stats.boardingSeconds += boarding;
+                stats.maxBoardingSeconds = std::max(stats.maxBoardingSeconds, boarding);
+                stats.edBoarders.set(now, ward.boarding());
+                releaseRoom(); // The boarder gives up their exam room
+                startWardStay(slot);
+                break;
+            }
+            case LEAVE_WARD:
+                --wardOccupied;
+                stats.wardOccupancy.set(now, wardOccupied);
+                stats.wardDischarges++;
+                patients.destroy(slot);
+                break;
+            case ESCALATE: escalate(slot); break;
+            case LEAVE: leave(slot); break;
+            case PATHWAY_ACTIONS: break;
+        }
+    }
+
+    // HIGH patients need a ventilator; the pathway decides what happens without one
+    void startTreatment(int slot) {
+        if (patients.priority[slot] == HIGH) {
+            if (ventilatorsFree == 0) {
+                fire(slot, NO_VENTILATOR);
+                return;
+            }
+            --ventilatorsFree;
+            patients.ventilator[slot] = 1;
+        }
+        scheduleTreatmentEnd(slot);
+    }
+
+    void scheduleTreatmentEnd(int slot) {
+        SimTime end = now + secondsToTicks(cfg.treatmentSeconds);
+        stats.treatmentSeconds += ticksToSeconds(std::min(end, horizon) - now);
+        schedule(end, TREATMENT_END, slot);
+    }
+
+    // The ED is gridlocked while boarders hold every exam room in service: no
+    // one else can be treated until a ward bed frees one. Rooms added by
+    // resource generation count, rooms out of service do not; call this after
+    // either number changes.
+    void updateGridlock() {
+        int boarding = ward.boarding();
+        stats.gridlock.set(now, boarding > 0 && boarding >= roomsFree + roomsHeld);
+    }
+
+    // A patient gives up their exam room
+    void releaseRoom() {
+        --roomsHeld;
+        releaseUnit(EXAM_ROOM);
+        updateGridlock();
+    }
+
+    void countVentilatorShortage() {
+        stats.ventilatorShortages++;
+        if (unitsUp[VENTILATOR] < cfg.ventilators) stats.ventilatorShortagesDuringOutage++;
+    }
+
+    void handleTreatmentEnd(int slot) {
+        if (patients.ventilator[slot]) releaseUnit(VENTILATOR);
+        patients.ventilator[slot] = 0;
+        ++doctorsFree;
+        ++nursesFree;
+        ++idleDoctors;
+        Priority triage = patients.triage[slot];
+        stats.treated[triage]++;
+
+        if (uniform() < cfg.admitProbability[patients.priority[slot]]) {
+            stats.admitted[triage]++;
+            if (ward.freeBeds() > 0) {
+                fire(slot, ADMITTED);
+            } else if (cfg.maxBoarders > 0 && ward.boarding() >= cfg.maxBoarders) {
+                stats.boardingFullTransfers++;
+                fire(slot, BOARDING_FULL);
+            } else {
+                fire(slot, NO_BED);
+            }
+        } else {
+            fire(slot, TREATED);
+        }
+        dispatch();
+    }
+
+    void startWardStay(int slot) {
+        ++wardOccupied;
+        stats.wardOccupancy.set(now, wardOccupied);
+        std::exponential_distribution<double> stay(1.0 / (cfg.wardStayMeanDays * TICKS_PER_DAY));
+        schedule(now + (SimTime)stay(rng) + 1, WARD_DISCHARGE, slot);
+    }
+
+    void handleWardDischarge(int slot) {
+        fire(slot, WARD_DONE);
+        int boarder = ward.discharge();
+        if (boarder >= 0) {
+            fire(boarder, BED_ASSIGNED);
+            dispatch();
+        }
+    }
+
+    void handleResourceGeneration() {
+        doctorsFree += std::uniform_int_distribution<int>(0, 1)(rng);
+        nursesFree += std::uniform_int_distribution<int>(0, 1)(rng);
+        roomsFree += std::uniform_int_distribution<int>(0, 1)(rng);
+        updateGridlock();
+        schedule(now + secondsToTicks(cfg.resourceIntervalSeconds), RESOURCE_GENERATION);
+        dispatch();
+    }
+
+    void handleBreakStart() {
+        if (doctorsFree > 0) {
+            --doctorsFree;
+            schedule(now + secondsToTicks(cfg.breakDurationSeconds), BREAK_END);
+        }
+        schedule(now + secondsToTicks(cfg.breakIntervalSeconds), BREAK_START);
+    }
+
+    void handleBreakEnd() {
+        ++doctorsFree;
+        dispatch();
+    }
+
+    // Arms the deterioration timer of a waiting patient; dispatch cancels it
+    void scheduleDeterioration(int slot) {
+        Priority priority = patients.priority[slot];
+        double meanMinutes = cfg.deteriorationMeanMinutes[priority];
+        if (priority == HIGH || meanMinutes <= 0) return;
+        std::exponential_distribution<double> delay(1.0 / (meanMinutes * 60 * TICKS_PER_SECOND));
+        patients.deteriorationTimer[slot] = scheduleCancellable(now + (SimTime)delay(rng) + 1, DETERIORATION, slot);
+    }
+
+    void handleDeterioration(int slot) {
+        patients.deteriorationTimer[slot] = NO_TIMER;
+        fire(slot, WORSENED);
+    }
+
+    void escalate(int slot) {
+        Priority& priority = patients.priority[slot];
+        if (priority == patients.triage[slot]) stats.deteriorated[priority]++;
+        stats.escalations++;
+        priority = Priority(priority - 1);
+        waiting.reprioritize(slot, priority);
+        scheduleDeterioration(slot);
+        // Patience is drawn again at the new priority's rate
+        events.cancel(patients.abandonTimer[slot]);
+        patients.abandonTimer[slot] = NO_TIMER;
+        scheduleAbandonment(slot);
+    }
+
+    // Arms the timer after which a waiting patient leaves without being seen
+    void scheduleAbandonment(int slot) {
+        double meanMinutes = cfg.abandonMeanMinutes[patients.priority[slot]];
+        if (meanMinutes <= 0) return;
+        std::exponential_distribution<double> patience(1.0 / (meanMinutes * 60 * TICKS_PER_SECOND));
+        patients.abandonTimer[slot] = scheduleCancellable(now + (SimTime)patience(rng) + 1, ABANDONMENT, slot);
+    }
+
+    void handleAbandonment(int slot) {
+        patients.abandonTimer[slot] = NO_TIMER;
+        fire(slot, PATIENCE_OUT);
+    }
+
+    void leave(int slot) {
+        events.cancel(patients.deteriorationTimer[slot]);
+        patients.deteriorationTimer[slot] = NO_TIMER;
+        waiting.remove(slot);
+        stats.queueLength.set(now, (int)waiting.size());
+        stats.abandoned[patients.triage[slot]]++;
+        stats.abandonWaitSeconds += ticksToSeconds(now - patients.arrival[slot]);
+        patients.destroy(slot);
+    }
+
+    int& freeUnits(EquipmentKind kind) {
+        return kind == VENTILATOR ? ventilatorsFree : roomsFree;
+    }
+
+    // Returns a unit to the pool, unless a failed unit or a patient was waiting for it
+    void releaseUnit(EquipmentKind kind) {
+        if (!pendingOutages[kind].empty()) {
+            int unit = pendingOutages[kind].front();
+            pendingOutages[kind].pop_front();
+            beginOutage(unit);
+        } else if (kind == VENTILATOR && !ventilatorQueue.empty()) {
+            int slot = ventilatorQueue.front();
+            ventilatorQueue.pop_front();
+            ++ventilatorsFree;
+            fire(slot, VENTILATOR_FREE);
+        } else {
+            ++freeUnits(kind);
+        }
+    }
+
+    void scheduleFailure(int unit) {
+        double mtbfHours = units.kind[unit] == VENTILATOR ? cfg.ventilatorMtbfHours : cfg.roomMtbfHours;
+        if (mtbfHours <= 0) return;
+        std::exponential_distribution<double> upTime(1.0 / (mtbfHours * 3600 * TICKS_PER_SECOND));
+        schedule(now + (SimTime)upTime(rng) + 1, UNIT_FAILURE, unit);
+        units.failureScheduled[unit] = 1;
+    }
+
+    // Takes a unit out of service now if one of its kind is free, otherwise when
+    // the next one is released
+    void takeOutOfService(int unit, UnitState reason) {
+        EquipmentKind kind = units.kind[unit];
+        units.state[unit] = reason;
+        if (freeUnits(kind) > 0) {
+            --freeUnits(kind);
+            beginOutage(unit);
+        } else {
+            pendingOutages[kind].push_back(unit);
+        }
+    }
+
+    void beginOutage(int unit) {
+        EquipmentKind kind = units.kind[unit];
+        stats.unitsInService[kind].set(now, --unitsUp[kind]);
+        if (kind == EXAM_ROOM) updateGridlock();
+
+        double hours;
+        if (units.state[unit] == UNIT_FAILED) {
+            double mttr = kind == VENTILATOR ? cfg.ventilatorMttrHours : cfg.roomMttrHours;
+            hours = lognormalFromNormal(mttr, cfg.repairCv, std::normal_distribution<double>(0.0, 1.0)(rng));
+        } else {
+            hours = kind == VENTILATOR ? cfg.ventilatorMaintenanceHours : cfg.roomMaintenanceHours;
+        }
+        schedule(now + secondsToTicks(hours * 3600), UNIT_BACK_IN_SERVICE, unit);
+    }
+
+    void handleUnitFailure(int unit) {
+        units.failureScheduled[unit] = 0;
+        if (units.state[unit] != UNIT_UP) return; // Already down; the clock restarts after it returns
+        stats.failures[units.kind[unit]]++;
+        takeOutOfService(unit, UNIT_FAILED);
+    }
+
+    void handleBackInService(int unit) {
+        EquipmentKind kind = units.kind[unit];
+        units.state[unit] = UNIT_UP;
+        stats.unitsInService[kind].set(now, ++unitsUp[kind]);
+        releaseUnit(kind);
+        if (kind == EXAM_ROOM) updateGridlock();
+        if (!units.failureScheduled[unit]) scheduleFailure(unit);
+        dispatch();
+    }
+
+    void handleMaintenanceStart(int unit) {
+        EquipmentKind kind = units.kind[unit];
+        double interval = kind == VENTILATOR ? cfg.ventilatorMaintenanceIntervalHours : cfg.roomMaintenanceIntervalHours;
+        schedule(now + secondsToTicks(interval * 3600), MAINTENANCE_START, unit);
+        if (units.state[unit] != UNIT_UP) return; // Skip the window while the unit is under repair
+        stats.maintenanceWindows[kind]++;
+        takeOutOfService(unit, UNIT_MAINTENANCE);
+    }
+
+    void startEquipmentProcesses() {
+        int counts[2] = {cfg.ventilators, cfg.examRooms};
+        double intervals[2] = {cfg.ventilatorMaintenanceIntervalHours, cfg.roomMaintenanceIntervalHours};
+        for (int kind = 0; kind < 2; ++kind) {
+            unitsUp[kind] = counts[kind];
+            stats.unitsInService[kind].set(0, counts[kind]);
+            for (int i = 0; i < counts[kind]; ++i) {
+                int unit = units.create(EquipmentKind(kind));
+                scheduleFailure(unit);
+                if (intervals[kind] > 0) {
+                    // Stagger the windows so units of a kind are not serviced together
+                    SimTime first = secondsToTicks(intervals[kind] * 3600 * (i + 1) / counts[kind]);
+                    schedule(first, MAINTENANCE_START, unit);
+                }
+            }
+        }
+    }
+
+public:
+    // The configuration must pass checkConfig (main and Simulation::create
+    // check it) and must outlive the engine
+    DiscreteEventSimulation(const SimConfig& config, unsigned int seed) : cfg(config), events(config.eventList) {
+        std::string error;
+        pathway.compile(config.transitions, error);
+        reset(seed);
+    }
+
+    // Takes up a changed configuration (same object); call reset() afterwards
+    void configure() {
+        std::string error;
+        pathway.compile(cfg.transitions, error);
+        events = CancellableEventList<Event>(cfg.eventList);
+    }
+
+    // Back to time zero with a new seed. Every container is emptied rather
+    // than rebuilt, so the next run reuses the memory of this one.
+    void reset(unsigned int seed) {
+        rng.seed(seed);
+        now = 0;
+        horizon = secondsToTicks(cfg.horizonSeconds);
+        nextSeq = 0;
+        events.clear();
+        waiting.clear();
+        patients.clear();
+        nextPatientId = 1;
+        ventilatorQueue.clear();
+        doctorsFree = cfg.doctors;
+        nursesFree = cfg.nurses;
+        roomsFree = cfg.examRooms;
+        roomsHeld = 0;
+        ventilatorsFree = cfg.ventilators;
+        idleDoctors = cfg.doctorThreads;
+        wardOccupied = 0;
+        ward.reset(cfg.wardBeds);
+        stats.reset();
+        units.clear();
+        for (auto& outages : pendingOutages) outages.clear();
+        unitsUp[VENTILATOR] = unitsUp[EXAM_ROOM] = 0;
+    }
+
+    // Schedules the first arrival and the periodic processes
+    void start() {
+        int gap = std::uniform_int_distribution<int>(cfg.arrivalMinSeconds, cfg.arrivalMaxSeconds)(rng);
+        schedule(gap * TICKS_PER_SECOND, ARRIVAL);
+        if (cfg.dynamicResources) schedule(secondsToTicks(cfg.resourceIntervalSeconds), RESOURCE_GENERATION);
+        if (cfg.staffBreaks) schedule(secondsToTicks(cfg.breakIntervalSeconds), BREAK_START);
+        startEquipmentProcesses();
+    }
+
+    void run() {
+        start();
+        runUntil([] { return false; });
+    }
+
+    // Processes events until stop() holds after one of them (returns true) or
+    // until the horizon (returns false). A copy of the engine made at a stop
+    // can be reseeded and continued on its own: that is how the splitting mode
+    // clones a trajectory.
+    template <typename Stop>
+    bool runUntil(Stop stop) {
+        while (!events.empty() && events.top().time <= horizon) {
+            Event event = events.top();
+            events.pop();
+            now = event.time;
+            stats.eventsProcessed++;
+
+            switch (event.type) {
+                case ARRIVAL: handleArrival(); break;
+                case TREATMENT_END: handleTreatmentEnd(event.subject); break;
+                case WARD_DISCHARGE: handleWardDischarge(event.subject); break;
+                case RESOURCE_GENERATION: handleResourceGeneration(); break;
+                case BREAK_START: handleBreakStart(); break;
+                case BREAK_END: handleBreakEnd(); break;
+                case UNIT_FAILURE: handleUnitFailure(event.subject); break;
+                case UNIT_BACK_IN_SERVICE: handleBackInService(event.subject); break;
+                case MAINTENANCE_START: handleMaintenanceStart(event.subject); break;
+                case DETERIORATION: handleDeterioration(event.subject); break;
+                case RETURN_VISIT: handleReturnVisit(Priority(event.subject)); break;
+                case ABANDONMENT: handleAbandonment(event.subject); break;
+            }
+            if (stop()) return true;
+        }
+        now = horizon;
+        return false;
+    }
+
+    void reseed(unsigned int seed) { rng.seed(seed); }
+
+    // Importance of a state for ventilator shortages: ventilators not free
+    // (in use or out of service) plus HIGH patients waiting for a ventilator or
+    // a team. It is measured against the installed ventilators, so a failure
+    // raises it rather than lowering it, and a shortage needs it above
+    // cfg.ventilators.
+    int ventilatorPressure() const {
+        return cfg.ventilators - ventilatorsFree + (int)ventilatorQueue.size() + waiting.waitingAt(HIGH);
+    }
+
+    const Stats& statistics() const { return stats; }
+    const SimConfig& configuration() const { return cfg; }
+    SimTime currentTime() const { return now; }
+    size_t pendingEvents() const { return events.size(); }
+    const CancellableEventList<Event>::Metrics& eventListStatistics() const { return events.statistics(); }
+    int waitingPatients() const { return (int)waiting.size(); }
+    int boardingPatients() const { return ward.boarding(); }
+
+    // Census of the patients currently in a state, a linear scan of one component
+    int patientsIn(PatientState state) const {
+        return (int)std::count(patients.state.begin(), patients.state.end(), state);
+    }
+};
+
+#endif
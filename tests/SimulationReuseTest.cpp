@@ -0,0 +1,83 @@
+// Checks that a reused Simulation gives the same results as a new one: for
+// each event list, create, run, reset(seed), run again, and compare against a
+// fresh object with the same seed.
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "Simulation.h"
+
+using namespace std;
+
+// Function to compare two results field by field; prints the first difference
+static bool sameResults(const SimulationResults& a, const SimulationResults& b, const string& what) {
+    auto differ = [&](const char* field) {
+        cerr << what << ": " << field << " differs" << endl;
+        return false;
+    };
+    if (a.simulatedSeconds != b.simulatedSeconds) return differ("simulatedSeconds");
+    if (a.eventsProcessed != b.eventsProcessed) return differ("eventsProcessed");
+    for (int p = 0; p < PRIORITY_LEVELS; ++p) {
+        if (a.arrived[p] != b.arrived[p]) return differ("arrived");
+        if (a.treated[p] != b.treated[p]) return differ("treated");
+        if (a.admitted[p] != b.admitted[p]) return differ("admitted");
+        if (a.abandoned[p] != b.abandoned[p]) return differ("abandoned");
+        if (a.meanWaitSeconds[p] != b.meanWaitSeconds[p]) return differ("meanWaitSeconds");
+        if (a.maxWaitSeconds[p] != b.maxWaitSeconds[p]) return differ("maxWaitSeconds");
+    }
+    if (a.meanQueueLength != b.meanQueueLength) return differ("meanQueueLength");
+    if (a.meanWardOccupancy != b.meanWardOccupancy) return differ("meanWardOccupancy");
+    if (a.boarded != b.boarded) return differ("boarded");
+    if (a.transfers != b.transfers) return differ("transfers");
+    if (a.gridlockSeconds != b.gridlockSeconds) return differ("gridlockSeconds");
+    if (a.ventilatorShortages != b.ventilatorShortages) return differ("ventilatorShortages");
+    if (a.stillWaiting != b.stillWaiting) return differ("stillWaiting");
+    return true;
+}
+
+int main() {
+    // A day with ward admissions, abandonment, deterioration and return
+    // visits, so that runs cancel timers and keep events days ahead
+    SimConfig config;
+    config.horizonSeconds = 24 * 60 * 60;
+    config.wardBeds = 4;
+    config.admitProbability[HIGH] = 0.5;
+    config.admitProbability[MEDIUM] = 0.2;
+    config.abandonMeanMinutes[LOW] = 5;
+    config.deteriorationMeanMinutes[MEDIUM] = 10;
+    config.returnProbability[LOW] = 0.1;
+
+    int failures = 0;
+    for (const char* eventList : {"tiered", "calendar", "heap", "pairing", "radix"}) {
+        config.eventList = eventList;
+        config.seed = 11;
+        string error;
+        unique_ptr<Simulation> reused = Simulation::create(config, error);
+        if (!reused) {
+            cerr << eventList << ": " << error << endl;
+            return 1;
+        }
+        SimulationResults first = reused->run();
+        if (first.eventsProcessed == 0) {
+            cerr << eventList << ": the run processed no events" << endl;
+            ++failures;
+        }
+
+        for (unsigned int seed : {12u, 11u}) {
+            reused->reset(seed);
+            SimulationResults again = reused->run();
+            config.seed = seed;
+            unique_ptr<Simulation> fresh = Simulation::create(config, error);
+            string what = string(eventList) + ", seed " + to_string(seed);
+            if (!sameResults(again, fresh->run(), what)) ++failures;
+            if (seed == 11 && !sameResults(again, first, what + " after reuse")) ++failures;
+        }
+        cout << eventList << ": " << first.eventsProcessed << " events" << endl;
+    }
+    if (failures > 0) {
+        cerr << failures << " comparisons failed" << endl;
+        return 1;
+    }
+    return 0;
+}
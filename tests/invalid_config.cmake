@@ -0,0 +1,24 @@
+# Runs every mode that runs the model with one invalid option and checks that it
+# is rejected with exit status 1 and a message, before anything runs (not
+# killed by a signal or run to a meaningless result). Run by ctest with
+# SIMULATION set.
+function(expect_rejected mode option message)
+    execute_process(COMMAND ${SIMULATION} --mode=${mode} ${option} --horizonSeconds=600 --replications=2
+                    RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE errors)
+    if(NOT result STREQUAL "1" OR NOT errors MATCHES "${message}")
+        message(FATAL_ERROR "--mode=${mode} ${option} was not rejected (${result}):\n${output}${errors}")
+    endif()
+endfunction()
+
+expect_rejected(des --arrivalMaxSeconds=0 "Invalid configuration: arrivalMaxSeconds")
+expect_rejected(realtime --doctors=0 "Invalid configuration: doctors")
+expect_rejected(lockstep --nurses=0 "Invalid configuration: nurses")
+expect_rejected(replicate --examRooms=0 "Invalid configuration: examRooms")
+expect_rejected(farm --nurses=0 "Invalid configuration: nurses")
+expect_rejected(bench-pinning --doctorThreads=0 "Invalid configuration: doctorThreads")
+expect_rejected(bench-hugepages --treatmentSeconds=0 "Invalid configuration: treatmentSeconds")
+expect_rejected(validate --nurses=0 "Invalid configuration: nurses")
+expect_rejected(splitting --examRooms=0 "Invalid configuration: examRooms")
+expect_rejected(des --eventList=list "Invalid configuration: unknown event list")
+expect_rejected(des --hugePages=always "Invalid configuration: unknown hugePages")
+expect_rejected(sweep --sweepFactors=nurses=0:4 "Bad sweepFactors")
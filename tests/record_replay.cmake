@@ -0,0 +1,33 @@
+# Records a threaded run, replays it and checks that the replay gives the same
+# event log. Run by ctest with SIMULATION (the program) and OUTPUT_DIR set.
+file(MAKE_DIRECTORY ${OUTPUT_DIR})
+set(options --horizonSeconds=300 --clockSpeed=200 --seed=3 --wardBeds=2 --admitProbabilityHigh=0.5
+    --wardStayMeanDays=0.001 --abandonMeanMinutesLow=3 --deteriorationMeanMinutesMedium=4
+    --ventilatorMtbfHours=0.05 --ventilatorMttrHours=0.02)
+
+execute_process(COMMAND ${SIMULATION} ${options} --eventLog=${OUTPUT_DIR}/recorded.log
+                        --recordSchedule=${OUTPUT_DIR}/run.sched
+                RESULT_VARIABLE result OUTPUT_QUIET)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Recording failed (${result})")
+endif()
+
+execute_process(COMMAND ${SIMULATION} ${options} --eventLog=${OUTPUT_DIR}/replayed.log
+                        --replaySchedule=${OUTPUT_DIR}/run.sched
+                RESULT_VARIABLE result OUTPUT_QUIET ERROR_VARIABLE errors)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Replay failed (${result}): ${errors}")
+endif()
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT_DIR}/recorded.log ${OUTPUT_DIR}/replayed.log
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "The replayed event log differs from the recorded one")
+endif()
+
+# A replay with other options must not pass
+execute_process(COMMAND ${SIMULATION} ${options} --doctors=2 --replaySchedule=${OUTPUT_DIR}/run.sched
+                RESULT_VARIABLE result OUTPUT_QUIET ERROR_QUIET)
+if(result EQUAL 0)
+    message(FATAL_ERROR "A replay that diverged reported success")
+endif()
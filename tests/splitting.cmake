@@ -0,0 +1,8 @@
+# Checks importance splitting against plain Monte Carlo on a case that is not
+# rare (a shortage in about a third of the runs). Run by ctest with SIMULATION set.
+execute_process(COMMAND ${SIMULATION} --mode=splitting --doctors=8 --doctorThreads=8 --nurses=8 --examRooms=8
+                        --ventilators=4 --treatmentSeconds=8 --horizonDays=0.05 --seed=2
+                RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE errors)
+if(NOT result EQUAL 0 OR NOT output MATCHES "Splitting and plain Monte Carlo agree")
+    message(FATAL_ERROR "Splitting disagrees with plain Monte Carlo (${result}):\n${output}${errors}")
+endif()
@@ -0,0 +1,34 @@
+# Runs the ward_gridlock scenario, whose ward admits far more patients than
+# it has beds. Without a boarding cap the report must show the ED gridlocked by
+# boarders; with the scenario's cap it must not. The gridlock counts the rooms
+# in service: rooms added by resource generation keep the ED out of it, and
+# rooms out for repair bring it on with fewer boarders. Run by ctest with
+# SIMULATION and SCENARIO set.
+execute_process(COMMAND ${SIMULATION} --scenario=${SCENARIO} --seed=1 --maxBoarders=0
+                RESULT_VARIABLE result OUTPUT_VARIABLE output)
+if(NOT result EQUAL 0 OR NOT output MATCHES "ED gridlocked \\(boarders in every exam room\\): [1-9][0-9]*\\.[0-9]+ h")
+    message(FATAL_ERROR "An uncapped run did not report the gridlock (${result}):\n${output}")
+endif()
+
+execute_process(COMMAND ${SIMULATION} --scenario=${SCENARIO} --seed=1
+                RESULT_VARIABLE result OUTPUT_VARIABLE output)
+if(NOT result EQUAL 0 OR NOT output MATCHES "ED gridlocked \\(boarders in every exam room\\): 0\\.00 h"
+   OR NOT output MATCHES "at the boarding cap")
+    message(FATAL_ERROR "The boarding cap did not prevent the gridlock (${result}):\n${output}")
+endif()
+
+# A room is added every 20 s on average, far faster than boarders accumulate
+execute_process(COMMAND ${SIMULATION} --scenario=${SCENARIO} --seed=1 --maxBoarders=0 --dynamicResources=true
+                RESULT_VARIABLE result OUTPUT_VARIABLE output)
+if(NOT result EQUAL 0 OR NOT output MATCHES "ED gridlocked \\(boarders in every exam room\\): 0\\.00 h")
+    message(FATAL_ERROR "Rooms added by resource generation did not count (${result}):\n${output}")
+endif()
+
+# Long repairs keep about 1.5 of the 4 rooms in service, so fewer than 4
+# boarders gridlock the ED most of the time
+execute_process(COMMAND ${SIMULATION} --scenario=${SCENARIO} --seed=1 --maxBoarders=0 --roomMtbfHours=24
+                        --roomMttrHours=48
+                RESULT_VARIABLE result OUTPUT_VARIABLE output)
+if(NOT result EQUAL 0 OR NOT output MATCHES "ED gridlocked \\(boarders in every exam room\\): [0-9.]+ h, [5-9][0-9]\\.[0-9]+% of the run")
+    message(FATAL_ERROR "Rooms out of service still counted (${result}):\n${output}")
+endif()